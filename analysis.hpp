@@ -0,0 +1,212 @@
+#pragma once
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "match.hpp"
+#include "openingbook.hpp"
+#include "positioncache.hpp"
+#include "search.hpp"
+#include "trace.hpp"
+
+using namespace std;
+
+/* one position to analyze, shared between the game loop and a pool worker */
+struct AnalysisRequest {
+    Match *match;  // owned snapshot, never the live game
+    int team_number;
+    chrono::steady_clock::time_point deadline;
+    atomic<bool> cancelled;
+    mutex lock;
+    condition_variable finished;
+    bool done = false;
+    SearchResult result;
+    vector<function<void()>> callbacks;
+    AnalysisRequest(Match *match, int team_number, chrono::steady_clock::time_point deadline)
+        : match(match), team_number(team_number), deadline(deadline), cancelled(false) {}
+    ~AnalysisRequest() { delete match; }
+    bool waitUntil(chrono::steady_clock::time_point time);
+    void notify(function<void()> callback);
+};
+
+/* @return true if the analysis finished before time */
+bool AnalysisRequest::waitUntil(chrono::steady_clock::time_point time) {
+    unique_lock<mutex> guard(lock);
+    return finished.wait_until(guard, time, [this]() { return done; });
+}
+
+/* callback runs on the worker thread once the analysis finishes, right away if it already has */
+void AnalysisRequest::notify(function<void()> callback) {
+    {
+        lock_guard<mutex> guard(lock);
+        if (!done) {
+            callbacks.push_back(callback);
+            return;
+        }
+    }
+    callback();
+}
+
+/**
+ * fixed number of search threads with a bounded queue
+ * when the queue is full new requests are refused instead of slowing down every game
+ * every worker searches through the same position cache when one is given
+ * positions in the opening book are answered from it without searching
+ */
+class AnalysisPool {
+   private:
+    mutex lock;
+    condition_variable has_work;
+    deque<shared_ptr<AnalysisRequest>> queue;
+    vector<thread> workers;
+    size_t max_queued;
+    PositionCache *cache;
+    OpeningBook *book;
+    bool stopping = false;
+    void work();
+
+   public:
+    AnalysisPool(size_t thread_count, size_t max_queued, PositionCache *cache = nullptr, OpeningBook *book = nullptr);
+    ~AnalysisPool();
+    bool submit(shared_ptr<AnalysisRequest> request);
+};
+
+AnalysisPool::AnalysisPool(size_t thread_count, size_t max_queued, PositionCache *cache, OpeningBook *book)
+    : max_queued(max_queued), cache(cache), book(book) {
+    if (thread_count == 0) thread_count = 1;
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers.push_back(thread(&AnalysisPool::work, this));
+    }
+}
+
+AnalysisPool::~AnalysisPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+        for (auto &request : queue) {
+            request->cancelled = true;
+        }
+    }
+    has_work.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+/* @return false if the pool is busy and the request was not queued */
+bool AnalysisPool::submit(shared_ptr<AnalysisRequest> request) {
+    {
+        lock_guard<mutex> guard(lock);
+        if (stopping || queue.size() >= max_queued) return false;
+        queue.push_back(request);
+    }
+    has_work.notify_one();
+    return true;
+}
+
+void AnalysisPool::work() {
+    TRACE_NAME_TRACK(nullptr, "analysis");
+    for (;;) {
+        shared_ptr<AnalysisRequest> request;
+        {
+            unique_lock<mutex> guard(lock);
+            has_work.wait(guard, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            request = queue.front();
+            queue.pop_front();
+        }
+        SearchResult result;
+        // requests that waited past their deadline or whose turn already ended are dropped
+        if (!request->cancelled && chrono::steady_clock::now() < request->deadline) {
+            TRACE_SPAN("analysis");
+            bool in_book = book != nullptr && book->find(*request->match, request->team_number, result);
+            if (!in_book) {
+                Search search(request->team_number, request->deadline, &request->cancelled, cache);
+                result = search.run(*request->match);
+            }
+        }
+        vector<function<void()>> callbacks;
+        {
+            lock_guard<mutex> guard(request->lock);
+            request->result = result;
+            request->done = true;
+            callbacks.swap(request->callbacks);
+        }
+        request->finished.notify_all();
+        for (auto &callback : callbacks) {
+            callback();
+        }
+    }
+}
+
+/**
+ * hints for one player action, the pending analysis is cancelled when the action ends
+ * the game is only copied once a hint is asked for, take_snapshot returns a new owned Match
+ * the game loop never blocks on it, it waits for the request to finish then calls takeResult
+ */
+class HintSession {
+   private:
+    AnalysisPool *pool;
+    function<Match *()> take_snapshot;
+    int team_number;
+    chrono::milliseconds time_limit;
+    shared_ptr<AnalysisRequest> pending;
+
+   public:
+    HintSession(AnalysisPool *pool, function<Match *()> take_snapshot, int team_number, chrono::milliseconds time_limit)
+        : pool(pool), take_snapshot(take_snapshot), team_number(team_number), time_limit(time_limit) {}
+    HintSession(const HintSession &other) = delete;
+    ~HintSession() { cancel(); }
+    void cancel();
+    shared_ptr<AnalysisRequest> request();
+    string takeResult();
+};
+
+/* drops the pending analysis, for when the position changes during the action */
+void HintSession::cancel() {
+    if (pending != nullptr) pending->cancelled = true;
+    pending = nullptr;
+}
+
+/* @return the pending analysis or a newly queued one, nullptr if the pool is busy */
+shared_ptr<AnalysisRequest> HintSession::request() {
+    if (pending == nullptr) {
+        auto deadline = chrono::steady_clock::now() + time_limit;
+        pending = make_shared<AnalysisRequest>(take_snapshot(), team_number, deadline);
+        if (!pool->submit(pending)) pending = nullptr;
+    }
+    return pending;
+}
+
+/* @return the hint to show, the pending analysis is kept if it is not finished yet */
+string HintSession::takeResult() {
+    if (pending == nullptr) return "Hints are busy right now. Try again later.";
+    SearchResult result;
+    {
+        lock_guard<mutex> guard(pending->lock);
+        if (!pending->done) return "Still thinking. Type hint again in a moment.";
+        result = pending->result;
+    }
+    pending = nullptr;
+    if (!result.has_move) return "No hint could be found in time.";
+    string evaluation;
+    if (result.score >= Search::WIN_SCORE / 2) {
+        evaluation = "winning";
+    } else if (result.score <= -Search::WIN_SCORE / 2) {
+        evaluation = "losing";
+    } else {
+        evaluation = (result.score > 0 ? "+" : "") + to_string(result.score);
+    }
+    return "Hint: " + result.best_move.toString() + " (evaluation " + evaluation + ", depth " + to_string(result.depth) + ")";
+}
+
+#endif /* ANALYSIS_HPP */
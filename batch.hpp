@@ -0,0 +1,364 @@
+#pragma once
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <cstdint>
+#include <vector>
+#include "match.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * plays many independent random games of one lineup in lockstep, one game per lane
+ * every extremity of every player is a column of lanes, so a tap is resolved for all lanes at once
+ * games only tap, so no count ever becomes 0 and every alive player can always act
+ * finished lanes start a new game right away until max_games have started, then stay idle
+ * so that long games are not cut off and undercounted
+ */
+class BatchSimulator {
+   public:
+    static const int SLOTS = 2 * MAX_EXTREMITIES;  // hands first, then feet
+    static const int MAX_ACTIONS = 1000;           // games this long are counted as draws
+
+   private:
+    int lanes;
+    int player_count;
+    int team_count;
+    vector<Player::Type> types;
+    vector<int> team_numbers;
+    vector<int> turns;
+    vector<int32_t> max_counts;   // per player slot, 0 if unused
+    int32_t largest_count = 0;    // of any extremity, so the most a tap can add
+    vector<bool> is_hand;         // per player slot
+    vector<int32_t> counts;       // [player slot][lane]
+    vector<int32_t> alive;        // [player slot][lane], -1 if alive else 0
+    vector<int32_t> added;        // [player slot][lane], count tapped onto the extremity this step
+    vector<int32_t> grown;        // [player][lane], -1 once a zombie grew its second hand
+    vector<int32_t> player_alive;  // [player][lane]
+    vector<int32_t> skipping;     // [player][lane]
+    vector<int32_t> team_alive;   // [team][lane]
+    vector<int32_t> teams_alive;  // [lane]
+    vector<int8_t> team_cursors;  // [team][lane], -1 before a team's first turn
+    vector<int8_t> current_team;  // [lane], -1 before the first turn
+    vector<int8_t> current_player;  // -1 for an idle lane
+    vector<int8_t> actions_left;
+    vector<int32_t> actions_made;
+    vector<int8_t> last_winners;  // [lane], team number of the lane's last finished game, 0 for a draw
+    vector<uint64_t> random_states;
+    uint64_t max_games;
+    uint64_t games_started = 0;
+    uint64_t games_finished = 0;
+    uint64_t draws = 0;
+    vector<uint64_t> wins;  // per team
+    int32_t *column(vector<int32_t> &table, int row) { return &table[(size_t)row * lanes]; }
+    uint32_t random(int lane);
+    void resetLane(int lane);
+    void startGame(int lane);
+    void nextTurn(int lane);
+    void chooseTaps();
+    void resolveTaps();
+    void updateAlive();
+
+   public:
+    BatchSimulator(vector<Player::Type> types, vector<int> team_numbers, int lanes, uint64_t max_games, uint64_t seed);
+    bool isDone() { return games_finished >= max_games; }
+    void step();
+    uint64_t getGamesFinished() { return games_finished; }
+    uint64_t getDraws() { return draws; }
+    vector<uint64_t> &getWins() { return wins; }
+    /* lane state in Match terms, slot is an index among the player's hands then MAX_EXTREMITIES + an index among the feet */
+    int getCurrentPlayer(int lane) { return current_player[lane]; }
+    bool isAlive(int player, int slot, int lane) { return column(alive, player * SLOTS + slot)[lane] != 0; }
+    int getCount(int player, int slot, int lane) { return column(counts, player * SLOTS + slot)[lane]; }
+    int getLastWinner(int lane) { return last_winners[lane]; }
+};
+
+BatchSimulator::BatchSimulator(vector<Player::Type> types, vector<int> team_numbers, int lanes, uint64_t max_games, uint64_t seed)
+    : lanes(lanes), player_count(types.size()), team_count(0), types(types), team_numbers(team_numbers), max_games(max_games) {
+    for (auto &team_number : team_numbers) {
+        if (team_number > team_count) team_count = team_number;
+    }
+    // the lineup is read from the real classes so that both engines agree on it
+    const char *keywords[] = {"human", "alien", "zombie", "doggo"};
+    max_counts.assign(player_count * SLOTS, 0);
+    is_hand.assign(player_count * SLOTS, false);
+    for (int p = 0; p < player_count; ++p) {
+        Player *prototype = createPlayer(keywords[types[p]], p + 1, nullptr, nullptr);
+        turns.push_back(prototype->getTurns());
+        for (size_t i = 0; i < prototype->getHandsSize(); ++i) {
+            max_counts[p * SLOTS + i] = prototype->getExtremity(Extremity::HAND, i)->getMaxCount();
+        }
+        if (types[p] == Player::ZOMBIE) max_counts[p * SLOTS + 1] = max_counts[p * SLOTS];
+        for (size_t i = 0; i < prototype->getFeetSize(); ++i) {
+            max_counts[p * SLOTS + MAX_EXTREMITIES + i] = prototype->getExtremity(Extremity::FOOT, i)->getMaxCount();
+        }
+        for (int i = 0; i < MAX_EXTREMITIES; ++i) {
+            is_hand[p * SLOTS + i] = true;
+        }
+        delete prototype;
+    }
+    for (auto &max_count : max_counts) {
+        largest_count = max(largest_count, max_count - 1);
+    }
+    counts.assign((size_t)player_count * SLOTS * lanes, 0);
+    alive.assign((size_t)player_count * SLOTS * lanes, 0);
+    added.assign((size_t)player_count * SLOTS * lanes, 0);
+    grown.assign((size_t)player_count * lanes, 0);
+    player_alive.assign((size_t)player_count * lanes, 0);
+    skipping.assign((size_t)player_count * lanes, 0);
+    team_alive.assign((size_t)team_count * lanes, 0);
+    teams_alive.assign(lanes, 0);
+    team_cursors.assign((size_t)team_count * lanes, -1);
+    current_team.assign(lanes, -1);
+    current_player.assign(lanes, -1);
+    actions_left.assign(lanes, 0);
+    actions_made.assign(lanes, 0);
+    last_winners.assign(lanes, 0);
+    wins.assign(team_count, 0);
+    for (int lane = 0; lane < lanes; ++lane) {
+        random_states.push_back((seed + lane + 1) * 0x9e3779b97f4a7c15ULL);
+        startGame(lane);
+    }
+}
+
+/* xorshift64*, one stream per lane so results don't depend on the lane count of other runs */
+uint32_t BatchSimulator::random(int lane) {
+    uint64_t &state = random_states[lane];
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (state * 0x2545f4914f6cdd1dULL) >> 32;
+}
+
+/* every extremity starts at 1, like the Extremity constructor, and a zombie's second hand is not grown yet */
+void BatchSimulator::resetLane(int lane) {
+    for (int p = 0; p < player_count; ++p) {
+        for (int s = 0; s < SLOTS; ++s) {
+            int row = p * SLOTS + s;
+            bool exists = max_counts[row] != 0 && !(types[p] == Player::ZOMBIE && s == 1);
+            column(counts, row)[lane] = 1;
+            column(alive, row)[lane] = exists ? -1 : 0;
+        }
+        column(grown, p)[lane] = 0;
+        column(player_alive, p)[lane] = -1;
+        column(skipping, p)[lane] = 0;
+    }
+    for (int t = 0; t < team_count; ++t) {
+        column(team_alive, t)[lane] = -1;
+        team_cursors[(size_t)t * lanes + lane] = -1;
+    }
+    teams_alive[lane] = team_count;
+    current_team[lane] = -1;
+    actions_made[lane] = 0;
+    nextTurn(lane);
+}
+
+void BatchSimulator::startGame(int lane) {
+    if (games_started < max_games) {
+        ++games_started;
+        resetLane(lane);
+    } else {
+        current_player[lane] = -1;
+    }
+}
+
+/* same order as Match::nextTurn, a team skips when every alive player in it is skipping */
+void BatchSimulator::nextTurn(int lane) {
+    for (;;) {
+        int team = current_team[lane] = (current_team[lane] + 1) % team_count;
+        if (!column(team_alive, team)[lane]) continue;
+        bool team_skipping = true;
+        for (int p = 0; p < player_count; ++p) {
+            if (team_numbers[p] == team + 1 && column(player_alive, p)[lane] && !column(skipping, p)[lane]) team_skipping = false;
+        }
+        if (team_skipping) {
+            for (int p = 0; p < player_count; ++p) {
+                if (team_numbers[p] == team + 1) column(skipping, p)[lane] = 0;
+            }
+            continue;
+        }
+        int8_t &cursor = team_cursors[(size_t)team * lanes + lane];
+        int player;
+        // walk the team's players in player number order, starting after the cursor
+        for (bool first = cursor < 0;; first = false) {
+            if (!first) {
+                do {
+                    cursor = (cursor + 1) % player_count;
+                } while (team_numbers[cursor] != team + 1);
+            } else {
+                cursor = 0;
+                while (team_numbers[cursor] != team + 1) ++cursor;
+            }
+            player = cursor;
+            if (!column(player_alive, player)[lane]) continue;
+            if (!column(skipping, player)[lane]) break;
+            column(skipping, player)[lane] = 0;
+        }
+        current_player[lane] = player;
+        actions_left[lane] = turns[player];
+        return;
+    }
+}
+
+/* picks a random alive extremity, a random alive enemy and a random alive target extremity per lane */
+void BatchSimulator::chooseTaps() {
+    int choices[SLOTS * MAX_PLAYERS];
+    for (int lane = 0; lane < lanes; ++lane) {
+        int player = current_player[lane];
+        if (player < 0) continue;
+        int size = 0;
+        for (int s = 0; s < SLOTS; ++s) {
+            if (column(alive, player * SLOTS + s)[lane]) choices[size++] = s;
+        }
+        int from = choices[random(lane) % size];
+        size = 0;
+        for (int p = 0; p < player_count; ++p) {
+            if (team_numbers[p] == team_numbers[player] || !column(player_alive, p)[lane]) continue;
+            for (int s = 0; s < SLOTS; ++s) {
+                if (column(alive, p * SLOTS + s)[lane]) choices[size++] = p * SLOTS + s;
+            }
+        }
+        int to = choices[random(lane) % size];
+        column(added, to)[lane] = column(counts, player * SLOTS + from)[lane];
+        // tapping a doggo with any other class skips the tapper's next turn
+        if (types[to / SLOTS] == Player::DOGGO && types[player] != Player::DOGGO) column(skipping, player)[lane] = -1;
+    }
+}
+
+/* Hand::isTapped and Foot::isTapped for every lane, then foot deaths skip and a zombie regrows */
+void BatchSimulator::resolveTaps() {
+    for (int p = 0; p < player_count; ++p) {
+        int32_t *skip = column(skipping, p);
+        for (int s = 0; s < SLOTS; ++s) {
+            int row = p * SLOTS + s;
+            int32_t max_count = max_counts[row];
+            if (max_count == 0) continue;
+            int32_t *count = column(counts, row);
+            int32_t *is_alive = column(alive, row);
+            int32_t *add = column(added, row);
+            bool skips = !is_hand[row] && types[p] != Player::ALIEN;
+            int lane = 0;
+#ifdef __AVX2__
+            __m256i max_vector = _mm256_set1_epi32(max_count);
+            __m256i below_max = _mm256_set1_epi32(max_count - 1);
+            // a tap from another class can add max_count or more, so the modulo may take several subtractions
+            int subtractions = (max_count - 1 + largest_count) / max_count;
+            for (; lane + 8 <= lanes; lane += 8) {
+                __m256i old_count = _mm256_loadu_si256((__m256i *)(count + lane));
+                __m256i old_alive = _mm256_loadu_si256((__m256i *)(is_alive + lane));
+                __m256i sum = _mm256_add_epi32(old_count, _mm256_loadu_si256((__m256i *)(add + lane)));
+                __m256i died;
+                if (is_hand[row]) {
+                    // taps never add 0, so a sum that reduces to 0 was a multiple of max
+                    for (int i = 0; i < subtractions; ++i) {
+                        sum = _mm256_sub_epi32(sum, _mm256_and_si256(_mm256_cmpgt_epi32(sum, below_max), max_vector));
+                    }
+                    died = _mm256_and_si256(old_alive, _mm256_cmpeq_epi32(sum, _mm256_setzero_si256()));
+                } else {
+                    died = _mm256_and_si256(old_alive, _mm256_cmpgt_epi32(sum, below_max));
+                }
+                _mm256_storeu_si256((__m256i *)(count + lane), sum);
+                _mm256_storeu_si256((__m256i *)(is_alive + lane), _mm256_andnot_si256(died, old_alive));
+                _mm256_storeu_si256((__m256i *)(add + lane), _mm256_setzero_si256());
+                if (skips) {
+                    __m256i old_skip = _mm256_loadu_si256((__m256i *)(skip + lane));
+                    _mm256_storeu_si256((__m256i *)(skip + lane), _mm256_or_si256(old_skip, died));
+                }
+                if (types[p] == Player::ZOMBIE && s == 0) {
+                    int32_t *spare_count = column(counts, row + 1);
+                    int32_t *spare_alive = column(alive, row + 1);
+                    int32_t *has_grown = column(grown, p);
+                    __m256i old_grown = _mm256_loadu_si256((__m256i *)(has_grown + lane));
+                    __m256i grows = _mm256_andnot_si256(old_grown, died);
+                    __m256i old_spare_count = _mm256_loadu_si256((__m256i *)(spare_count + lane));
+                    __m256i old_spare_alive = _mm256_loadu_si256((__m256i *)(spare_alive + lane));
+                    _mm256_storeu_si256((__m256i *)(spare_count + lane), _mm256_blendv_epi8(old_spare_count, _mm256_set1_epi32(1), grows));
+                    _mm256_storeu_si256((__m256i *)(spare_alive + lane), _mm256_or_si256(old_spare_alive, grows));
+                    _mm256_storeu_si256((__m256i *)(has_grown + lane), _mm256_or_si256(old_grown, grows));
+                }
+            }
+#endif
+            for (; lane < lanes; ++lane) {
+                int32_t sum = count[lane] + add[lane];
+                int32_t died;
+                if (is_hand[row]) {
+                    sum %= max_count;
+                    died = is_alive[lane] & (sum == 0 ? -1 : 0);
+                } else {
+                    died = is_alive[lane] & (sum >= max_count ? -1 : 0);
+                }
+                count[lane] = sum;
+                is_alive[lane] &= ~died;
+                add[lane] = 0;
+                if (skips) skip[lane] |= died;
+                if (types[p] == Player::ZOMBIE && s == 0) {
+                    int32_t grows = died & ~column(grown, p)[lane];
+                    if (grows) column(counts, row + 1)[lane] = 1;
+                    column(alive, row + 1)[lane] |= grows;
+                    column(grown, p)[lane] |= grows;
+                }
+            }
+        }
+    }
+}
+
+/* a player is alive with any alive extremity, a team with any alive player */
+void BatchSimulator::updateAlive() {
+    for (int t = 0; t < team_count; ++t) {
+        fill(column(team_alive, t), column(team_alive, t) + lanes, 0);
+    }
+    for (int p = 0; p < player_count; ++p) {
+        int32_t *is_alive = column(player_alive, p);
+        int32_t *is_team_alive = column(team_alive, team_numbers[p] - 1);
+        fill(is_alive, is_alive + lanes, 0);
+        for (int s = 0; s < SLOTS; ++s) {
+            if (max_counts[p * SLOTS + s] == 0) continue;
+            int32_t *extremity_alive = column(alive, p * SLOTS + s);
+            for (int lane = 0; lane < lanes; ++lane) {
+                is_alive[lane] |= extremity_alive[lane];
+            }
+        }
+        for (int lane = 0; lane < lanes; ++lane) {
+            is_team_alive[lane] |= is_alive[lane];
+        }
+    }
+    fill(teams_alive.begin(), teams_alive.end(), 0);
+    for (int t = 0; t < team_count; ++t) {
+        int32_t *is_team_alive = column(team_alive, t);
+        for (int lane = 0; lane < lanes; ++lane) {
+            teams_alive[lane] -= is_team_alive[lane];
+        }
+    }
+}
+
+/* one action in every lane */
+void BatchSimulator::step() {
+    chooseTaps();
+    resolveTaps();
+    updateAlive();
+    for (int lane = 0; lane < lanes; ++lane) {
+        if (current_player[lane] < 0) continue;
+        ++actions_made[lane];
+        if (teams_alive[lane] <= 1 || actions_made[lane] >= MAX_ACTIONS) {
+            ++games_finished;
+            last_winners[lane] = 0;
+            if (teams_alive[lane] == 1) {
+                for (int t = 0; t < team_count; ++t) {
+                    if (!column(team_alive, t)[lane]) continue;
+                    ++wins[t];
+                    last_winners[lane] = t + 1;
+                }
+            } else {
+                ++draws;
+            }
+            startGame(lane);
+        } else if (--actions_left[lane] <= 0) {
+            nextTurn(lane);
+        }
+    }
+}
+
+#endif /* BATCH_HPP */
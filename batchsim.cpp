@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "batch.hpp"
+#include "match.hpp"
+
+using namespace std;
+
+/**
+ * plays random tap-only games with the lane simulator and with Match, and compares their speed
+ * usage: batchsim <games> <class>:<group> <class>:<group> ... [-l lanes] [-s seed] [-c]
+ * example: batchsim 100000 human:1 zombie:2 doggo:2 -l 4096
+ * with -c the first lane is instead checked against Match after every action, for that many of its games
+ * build: g++ -std=c++11 -O2 -mavx2 batchsim.cpp -o batchsim (leave out -mavx2 for the scalar kernels)
+ */
+
+/* same policy as BatchSimulator::chooseTaps, on the real classes */
+Move chooseTap(Match &match, uint64_t &state) {
+    auto random = [&state]() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545f4914f6cdd1dULL) >> 32);
+    };
+    Player *player = match.getCurrentPlayer();
+    enum Extremity::Type modes[] = {Extremity::HAND, Extremity::FOOT};
+    vector<Move> choices;
+    Move move;
+    move.type = Move::TAP;
+    for (auto &mode : modes) {
+        for (int i = 0; i < player->getExtremitiesCount(mode); ++i) {
+            if (!player->getExtremity(mode, i)->isAlive()) continue;
+            move.mode = mode;
+            move.from = i;
+            choices.push_back(move);
+        }
+    }
+    move = choices[random() % choices.size()];
+    choices.clear();
+    for (auto &target : match.getPlayers()) {
+        if (target->getTeamNumber() == player->getTeamNumber() || !target->isAlive()) continue;
+        for (auto &mode : modes) {
+            for (int i = 0; i < target->getExtremitiesCount(mode); ++i) {
+                if (!target->getExtremity(mode, i)->isAlive()) continue;
+                move.target_player = target->getPlayerNumber();
+                move.target_mode = mode;
+                move.to = i;
+                choices.push_back(move);
+            }
+        }
+    }
+    return choices[random() % choices.size()];
+}
+
+/* @return false if the simulator's lane and match differ in whose turn it is or in any alive extremity */
+bool isSameState(Match &match, BatchSimulator &simulator, int lane) {
+    Player *current_player = match.getCurrentPlayer();
+    if (current_player == nullptr || current_player->getPlayerNumber() - 1 != simulator.getCurrentPlayer(lane)) return false;
+    enum Extremity::Type modes[] = {Extremity::HAND, Extremity::FOOT};
+    vector<Player *> &players = match.getPlayers();
+    for (size_t p = 0; p < players.size(); ++p) {
+        for (int m = 0; m < 2; ++m) {
+            for (int i = 0; i < MAX_EXTREMITIES; ++i) {
+                int slot = m * MAX_EXTREMITIES + i;
+                Extremity *extremity = i < players[p]->getExtremitiesCount(modes[m]) ? players[p]->getExtremity(modes[m], i) : nullptr;
+                bool alive = extremity != nullptr && extremity->isAlive();
+                if (alive != simulator.isAlive(p, slot, lane)) return false;
+                if (alive && extremity->getCount() != simulator.getCount(p, slot, lane)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * plays the first lane's games with Match too, from the same random stream, comparing them after every action
+ * the other lanes still run, so the vector kernels are checked as well when there are 8 or more
+ * @return false at the first difference, which is printed
+ */
+bool checkLane(Match &match, BatchSimulator &simulator, uint64_t games, int seed) {
+    uint64_t state = (seed + 1) * 0x9e3779b97f4a7c15ULL;
+    vector<Undo> undos(BatchSimulator::MAX_ACTIONS);
+    for (uint64_t game = 0; game < games; ++game) {
+        int actions = 0;
+        while (!match.isOver() && actions < BatchSimulator::MAX_ACTIONS) {
+            if (!isSameState(match, simulator, 0)) {
+                cout << "Game " << (game + 1) << " differs before action " << (actions + 1) << "." << endl;
+                return false;
+            }
+            Move move = chooseTap(match, state);
+            match.makeMove(move, undos[actions++]);
+            simulator.step();
+        }
+        Team *winning_team = match.getWinningTeam();
+        int winner = winning_team == nullptr ? 0 : winning_team->getTeamNumber();
+        if (simulator.getLastWinner(0) != winner) {
+            cout << "Game " << (game + 1) << " ends with team " << simulator.getLastWinner(0) << " winning instead of team " << winner << "." << endl;
+            return false;
+        }
+        while (actions > 0) {
+            match.unmakeMove(undos[--actions]);
+        }
+    }
+    cout << "Lane 0 matches Match over " << games << " games." << endl;
+    return true;
+}
+
+void printResults(string name, uint64_t games, uint64_t draws, vector<uint64_t> &wins, double seconds) {
+    cout << name << ": " << games << " games in " << seconds << "s, " << (uint64_t)(games / seconds) << " games/second" << endl;
+    for (size_t i = 0; i < wins.size(); ++i) {
+        cout << "  Team " << (i + 1) << " wins: " << (100.0 * wins[i] / games) << "%" << endl;
+    }
+    cout << "  Draws: " << (100.0 * draws / games) << "%" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4 || !isValidInt(argv[1]) || stoi(argv[1]) < 1) {
+        cerr << "Usage: batchsim <games> <class>:<group> <class>:<group> ... [-l lanes] [-s seed] [-c]" << endl;
+        return 1;
+    }
+    uint64_t games = stoll(argv[1]);
+    int lanes = 1024;
+    int seed = 1;
+    bool check = false;
+    vector<string> lineup;
+    for (int i = 2; i < argc; ++i) {
+        string argument = argv[i];
+        if ((argument == "-l" || argument == "-s") && i + 1 < argc && isValidInt(argv[i + 1])) {
+            (argument == "-l" ? lanes : seed) = stoi(argv[++i]);
+        } else if (argument == "-c") {
+            check = true;
+        } else {
+            lineup.push_back(argument);
+        }
+    }
+    vector<Player *> players;
+    if (lanes < 1 || !createLineup(lineup, players)) {
+        cerr << "Invalid players or groups. There must be 2 to 6 players in groups 1 to n." << endl;
+        return 1;
+    }
+    vector<Player::Type> types;
+    vector<int> team_numbers;
+    for (auto &player : players) {
+        types.push_back(player->getType());
+        team_numbers.push_back(player->getTeamNumber());
+    }
+#ifdef __AVX2__
+    cout << "Kernels: AVX2" << endl;
+#else
+    cout << "Kernels: scalar" << endl;
+#endif
+    if (check) {
+        // the first lane never runs out of games to start
+        BatchSimulator simulator(types, team_numbers, lanes, UINT64_MAX, seed);
+        Match match(players);
+        return checkLane(match, simulator, games, seed) ? 0 : 1;
+    }
+
+    // lockstep lanes
+    BatchSimulator simulator(types, team_numbers, lanes, games, seed);
+    auto start = chrono::steady_clock::now();
+    while (!simulator.isDone()) {
+        simulator.step();
+    }
+    double batch_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printResults("Lanes", simulator.getGamesFinished(), simulator.getDraws(), simulator.getWins(), batch_seconds);
+
+    // one Match at a time, undoing back to the start after every game
+    Match match(players);
+    vector<uint64_t> wins(match.getTeams().size(), 0);
+    uint64_t draws = 0;
+    uint64_t state = (seed + 1) * 0x9e3779b97f4a7c15ULL;
+    vector<Undo> undos(BatchSimulator::MAX_ACTIONS);
+    start = chrono::steady_clock::now();
+    for (uint64_t game = 0; game < games; ++game) {
+        int actions = 0;
+        while (!match.isOver() && actions < BatchSimulator::MAX_ACTIONS) {
+            Move move = chooseTap(match, state);
+            match.makeMove(move, undos[actions++]);
+        }
+        Team *winning_team = match.getWinningTeam();
+        if (winning_team == nullptr) {
+            ++draws;
+        } else {
+            ++wins[winning_team->getTeamNumber() - 1];
+        }
+        while (actions > 0) {
+            match.unmakeMove(undos[--actions]);
+        }
+    }
+    double object_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printResults("Objects", games, draws, wins, object_seconds);
+    cout << "Speedup: " << object_seconds / batch_seconds << "x" << endl;
+    return 0;
+}
@@ -29,6 +29,7 @@ class Extremity {
     Extremity(int max_count, enum Extremity::Type type)
         : type(type), max_count(max_count) {}
     virtual ~Extremity() {}
+    virtual Extremity *clone() = 0;
     enum Extremity::Type getType() { return type; }
     string getName() { return type == HAND ? "hand" : "foot"; }
     bool const isAlive() { return alive; }
@@ -37,6 +38,7 @@ class Extremity {
     int const getMaxCount() { return max_count; }
     bool tap(Extremity &other);
     bool setCount(int new_count);
+    void restore(int old_count, bool old_alive);
 };
 
 /**
@@ -60,9 +62,16 @@ bool Extremity::setCount(int new_count) {
     return false;
 }
 
+/* puts back a state saved before a tap or redistribution, even a dead one */
+void Extremity::restore(int old_count, bool old_alive) {
+    count = old_count;
+    alive = old_alive;
+}
+
 class Hand : public Extremity {
    public:
     Hand(int max_count) : Extremity(max_count, HAND) {}
+    Extremity *clone() override { return new Hand(*this); }
     void isTapped() override;
 };
 
@@ -77,6 +86,7 @@ void Hand::isTapped() {
 class Foot : public Extremity {
    public:
     Foot(int max_count) : Extremity(max_count, FOOT) {}
+    Extremity *clone() override { return new Foot(*this); }
     void isTapped() override;
 };
 
@@ -117,7 +127,10 @@ class Player {
     Player(Player::Type type, int player_number, int hand_count, int foot_count,
            int finger_count, int toe_count, ostream *output = &cout, istream *input = &cin,
            int turns = 1);
+    Player(const Player &other);
     virtual ~Player();
+    virtual Player *clone() = 0;
+    void setStreams(ostream *new_output, istream *new_input);
     Player::Type getType() { return type; }
     string getName() { return name; }
     int const getPlayerNumber() { return player_number; }
@@ -128,13 +141,20 @@ class Player {
     bool const isAlive() { return alive; }
     size_t getHandsSize() { return hands.size(); }
     size_t getFeetSize() { return feet.size(); }
+    Extremity *getExtremity(enum Extremity::Type mode, size_t index);
     bool attack(Player &other, string my_stats, string other_stats);
+    bool attack(Player &other_player, Extremity *my_ex, Extremity *other_ex);
     bool distribute(enum Extremity::Type mode, vector<int> change);
     virtual void skipTurn(bool force = false) { skip = true; }
     void hasBeenSkipped() { skip = false; }
+    void restoreState(bool old_alive, bool old_skip);
+    virtual void undoRegrow() {}
+    void forfeit();
     bool isSkipping() { return skip; }
     bool canMakeAnAction();
     string getStatus();
+    string getPrompt(vector<string> extra_keywords = vector<string>());
+    bool playLine(vector<Player *> &all_players, string line_string);
     string playWith(vector<Player *> &all_players);
 };
 
@@ -161,6 +181,38 @@ Player::Player(Player::Type type, int player_number, int hand_count, int foot_co
     }
 }
 
+/* deep copies extremities, streams are shared */
+Player::Player(const Player &other)
+    : type(other.type), name(other.name), player_number(other.player_number), team_number(other.team_number), skip(other.skip), alive(other.alive), max_fingers(other.max_fingers), max_toes(other.max_toes), output(other.output), input(other.input), turns(other.turns) {
+    for (auto &hand : other.hands) {
+        hands.push_back(hand->clone());
+    }
+    for (auto &foot : other.feet) {
+        feet.push_back(foot->clone());
+    }
+}
+
+void Player::setStreams(ostream *new_output, istream *new_input) {
+    output = new_output;
+    input = new_input;
+}
+
+void Player::restoreState(bool old_alive, bool old_skip) {
+    alive = old_alive;
+    skip = old_skip;
+}
+
+/* gives up, every extremity dies */
+void Player::forfeit() {
+    for (auto &hand : hands) {
+        hand->restore(hand->getCount(), false);
+    }
+    for (auto &foot : feet) {
+        foot->restore(foot->getCount(), false);
+    }
+    alive = false;
+}
+
 Player::~Player() {
     for (auto &hand : hands) {
         delete hand;
@@ -172,6 +224,7 @@ Player::~Player() {
 
 /* @return true if valid attack else false */
 bool Player::attack(Player &other_player, string my_stats, string other_stats) {
+    TRACE_SPAN("attack");
     Extremity *other_ex = other_player.getExtremity(other_stats);
     Extremity *my_ex = this->getExtremity(my_stats);
     if (my_ex == nullptr) {
@@ -181,6 +234,14 @@ bool Player::attack(Player &other_player, string my_stats, string other_stats) {
         outputTo(output, "Chosen target " + (string)(other_stats[0] == 'H' ? "hand" : "foot") + " is out of bounds.");
         return false;
     }
+    return attack(other_player, my_ex, other_ex);
+}
+
+/**
+ * assumes my_ex is this player's and other_ex is other_player's
+ * @return true if valid attack else false
+ */
+bool Player::attack(Player &other_player, Extremity *my_ex, Extremity *other_ex) {
     if (!my_ex->isAlive()) {
         outputTo(output, "Your chosen " + my_ex->getName() + " is dead.");
         return false;
@@ -205,6 +266,7 @@ bool Player::attack(Player &other_player, string my_stats, string other_stats) {
 
 /* @return true if valid mode and distribution else false */
 bool Player::distribute(enum Extremity::Type mode, vector<int> change) {
+    TRACE_SPAN("distribute");
     vector<Extremity *> extr;
     if (mode == Extremity::HAND) {
         extr = hands;
@@ -325,6 +387,11 @@ Extremity *Player::getExtremity(string mode) {
     return nullptr;
 }
 
+/* assumes index is in bounds */
+Extremity *Player::getExtremity(enum Extremity::Type mode, size_t index) {
+    return mode == Extremity::HAND ? hands[index] : feet[index];
+}
+
 string Player::getStatus() {
     string result = "P" + to_string(player_number) + name[0] + " (";
 
@@ -346,131 +413,162 @@ string Player::getStatus() {
     return result;
 }
 
+/* @return the line asking this player for a move, extra_keywords are offered after the actions */
+string Player::getPrompt(vector<string> extra_keywords) {
+    string keywords = "tap | disthands | distfeet";
+    for (auto &keyword : extra_keywords) {
+        keywords += " | " + keyword;
+    }
+    return "Player " + to_string(getPlayerNumber()) + ", enter your move. [" + keywords + "]";
+}
+
 /**
  * assumes player is available to play
- * @return a string of action madde
+ * tells the player why line_string is not a valid action
+ * @return true if line_string was a valid action and it has been made else false
  */
-string Player::playWith(vector<Player *> &all_players) {
-    string action_made;
-    bool valid_action = false;
-    while (!valid_action) {
-        string action, line_string;
-        outputTo(output, "Player " + to_string(getPlayerNumber()) + ", enter your move. [tap | disthands | distfeet]");
-        line_string = getlineFrom(input, output);
-        istringstream line(line_string);
-        line >> action;
-
-        if (action == "tap") {
-            if (!isValidString(line_string, 4)) {
-                outputTo(output, "Please enter a valid number of arguments.");
-                continue;
-            }
-            string from, to, player_num_arg;
-            unsigned int player_number;
-            line >> from >> player_num_arg >> to;
+bool Player::playLine(vector<Player *> &all_players, string line_string) {
+    TRACE_SPAN("playLine");
+    string action;
+    istringstream line(line_string);
+    line >> action;
+
+    if (action == "tap") {
+        if (!isValidString(line_string, 4)) {
+            outputTo(output, "Please enter a valid number of arguments.");
+            return false;
+        }
+        string from, to, player_num_arg;
+        unsigned int player_number;
+        line >> from >> player_num_arg >> to;
 
-            if (from.size() != 2 || to.size() != 2 || (from[0] != 'H' && from[0] != 'F') || (to[0] != 'H' && to[0] != 'F')) {
-                outputTo(output, "Please enter valid attack arguments");
-                continue;
-            }
-            if (isValidInt(player_num_arg)) {
-                player_number = stoi(player_num_arg);
-                if (!(1 <= player_number && player_number <= all_players.size())) {
-                    outputTo(output, "Player number out of bounds! Enter action again.");
-                    continue;
-                }
-            } else {
-                outputTo(output, "Player number must be an integer! Enter action again.");
-                continue;
-            }
-            Player *target = all_players[player_number - 1];
-            if (!target->isAlive()) {
-                outputTo(output, "Target player is dead. Enter action again.");
-                continue;
-            }
-            if (target->getTeamNumber() == this->getTeamNumber()) {
-                outputTo(output, "Friendly fire is not allowed! Enter action again.");
-                continue;
-            }
-            if (!attack(*target, from, to)) continue;
-
-        } else if (action == "disthands" || action == "distfeet") {
-            int alive_hands_count = getExtremitiesCount(Extremity::HAND, true);
-            int alive_feet_count = getExtremitiesCount(Extremity::FOOT, true);
-            if (!isValidString(line_string, (action == "disthands" ? alive_hands_count : alive_feet_count) + 1)) {
-                outputTo(output, "Please enter a valid number of arguments.");
-                continue;
-            }
-            if ((action == "disthands" ? alive_hands_count : alive_feet_count) <= 1) {
-                outputTo(output, "Unable to redistribute with only 1 alive " + (string)(action == "disthands" ? "hand" : "foot") + ".");
-                continue;
+        if (from.size() != 2 || to.size() != 2 || (from[0] != 'H' && from[0] != 'F') || (to[0] != 'H' && to[0] != 'F')) {
+            outputTo(output, "Please enter valid attack arguments");
+            return false;
+        }
+        if (isValidInt(player_num_arg)) {
+            player_number = stoi(player_num_arg);
+            if (!(1 <= player_number && player_number <= all_players.size())) {
+                outputTo(output, "Player number out of bounds! Enter action again.");
+                return false;
             }
+        } else {
+            outputTo(output, "Player number must be an integer! Enter action again.");
+            return false;
+        }
+        Player *target = all_players[player_number - 1];
+        if (!target->isAlive()) {
+            outputTo(output, "Target player is dead. Enter action again.");
+            return false;
+        }
+        if (target->getTeamNumber() == this->getTeamNumber()) {
+            outputTo(output, "Friendly fire is not allowed! Enter action again.");
+            return false;
+        }
+        if (!attack(*target, from, to)) return false;
+
+    } else if (action == "disthands" || action == "distfeet") {
+        int alive_hands_count = getExtremitiesCount(Extremity::HAND, true);
+        int alive_feet_count = getExtremitiesCount(Extremity::FOOT, true);
+        if (!isValidString(line_string, (action == "disthands" ? alive_hands_count : alive_feet_count) + 1)) {
+            outputTo(output, "Please enter a valid number of arguments.");
+            return false;
+        }
+        if ((action == "disthands" ? alive_hands_count : alive_feet_count) <= 1) {
+            outputTo(output, "Unable to redistribute with only 1 alive " + (string)(action == "disthands" ? "hand" : "foot") + ".");
+            return false;
+        }
 
-            vector<int> changes(action == "disthands" ? getExtremitiesCount(Extremity::HAND) : getExtremitiesCount(Extremity::FOOT));
-            vector<Extremity *> *extremities = action == "disthands" ? &hands : &feet;
-
-            bool is_valid = true;
-            for (size_t i = 0; i < changes.size(); ++i) {
-                string to_check;
-                if (extremities->at(i)->isAlive()) {
-                    line >> to_check;
-                    if (!isValidInt(to_check)) {
-                        is_valid = false;
-                        break;
-                    }
-                    changes[i] = stoi(to_check);
+        vector<int> changes(action == "disthands" ? getExtremitiesCount(Extremity::HAND) : getExtremitiesCount(Extremity::FOOT));
+        vector<Extremity *> *extremities = action == "disthands" ? &hands : &feet;
+
+        bool is_valid = true;
+        for (size_t i = 0; i < changes.size(); ++i) {
+            string to_check;
+            if (extremities->at(i)->isAlive()) {
+                line >> to_check;
+                if (!isValidInt(to_check)) {
+                    is_valid = false;
+                    break;
                 }
+                changes[i] = stoi(to_check);
             }
+        }
 
-            if (!is_valid) {
-                outputTo(output, "Please enter integer arguments only after " + action + ".");
-                continue;
-            }
+        if (!is_valid) {
+            outputTo(output, "Please enter integer arguments only after " + action + ".");
+            return false;
+        }
 
-            if (!distribute(action == "disthands" ? Extremity::HAND : Extremity::FOOT, changes)) continue;
+        if (!distribute(action == "disthands" ? Extremity::HAND : Extremity::FOOT, changes)) return false;
 
-        } else {
-            outputTo(output, "Invalid keyword! Try again.");
-            continue;
-        }
-        action_made = line_string;
-        valid_action = true;
+    } else {
+        outputTo(output, "Invalid keyword! Try again.");
+        return false;
     }
-    return action_made;
+    return true;
+}
+
+/**
+ * assumes player is available to play
+ * @return a string of action madde
+ */
+string Player::playWith(vector<Player *> &all_players) {
+    string line_string;
+    do {
+        outputTo(output, getPrompt());
+        line_string = getlineFrom(input, output);
+    } while (!playLine(all_players, line_string));
+    return line_string;
 }
 
 class Human : public Player {
    public:
     Human(int player_number, ostream *output = &cout, istream *input = &cin)
         : Player(HUMAN, player_number, 2, 2, 5, 5, output, input) {}
+    Player *clone() override { return new Human(*this); }
 };
 
 class Alien : public Player {
    public:
     Alien(int player_number, ostream *output = &cout, istream *input = &cin)
         : Player(ALIEN, player_number, 4, 2, 3, 2, output, input) {}
+    Player *clone() override { return new Alien(*this); }
     void skipTurn(bool force = false) override {
         if (force) Player::skipTurn();
     }
 };
 
 class Zombie : public Player {
+   private:
+    Extremity *spare_hand;  // made up front so that growing and ungrowing it never allocates
+
    public:
     Zombie(int player_number, ostream *output = &cout, istream *input = &cin)
-        : Player(ZOMBIE, player_number, 1, 0, 4, 0, output, input, 2) {}
+        : Player(ZOMBIE, player_number, 1, 0, 4, 0, output, input, 2), spare_hand(new Hand(4)) { hands.reserve(2); }
+    Zombie(const Zombie &other)
+        : Player(other), spare_hand(other.spare_hand == nullptr ? nullptr : other.spare_hand->clone()) { hands.reserve(2); }
+    ~Zombie() { delete spare_hand; }
+    Player *clone() override { return new Zombie(*this); }
     void attackedBy(Player &other, Extremity &other_ex, Extremity &my_ex) override {
         if (hands.size() == 1 && !my_ex.isAlive()) {  // starting hand dies
-            Hand *new_hand = new Hand(4);
-            hands.push_back(new_hand);
+            hands.push_back(spare_hand);
+            spare_hand = nullptr;
         }
         Player::attackedBy(other, other_ex, my_ex);
     }
+    void undoRegrow() override {
+        spare_hand = hands.back();
+        hands.pop_back();
+        spare_hand->restore(1, true);
+    }
 };
 
 class Doggo : public Player {
    public:
     Doggo(int player_number, ostream *output = &cout, istream *input = &cin)
         : Player(DOGGO, player_number, 0, 4, 0, 4, output, input) {}
+    Player *clone() override { return new Doggo(*this); }
     void attackedBy(Player &other, Extremity &other_ex, Extremity &my_ex) override {
         Player::attackedBy(other, other_ex, my_ex);
         if (other.getType() != this->getType()) {  // not doggo type
@@ -479,6 +577,20 @@ class Doggo : public Player {
     }
 };
 
+/* @return new player of the chosen class else std::nullptr if keyword is invalid */
+Player *createPlayer(string type, int player_number, ostream *output = &cout, istream *input = &cin) {
+    if (type == "Human" || type == "human" || type == "1") {
+        return new Human(player_number, output, input);
+    } else if (type == "Alien" || type == "alien" || type == "2") {
+        return new Alien(player_number, output, input);
+    } else if (type == "Zombie" || type == "zombie" || type == "3") {
+        return new Zombie(player_number, output, input);
+    } else if (type == "Doggo" || type == "doggo" || type == "4") {
+        return new Doggo(player_number, output, input);
+    }
+    return nullptr;
+}
+
 class Team {
    private:
     int team_number;
@@ -488,6 +600,7 @@ class Team {
 
    public:
     Team(int team_number);
+    Team(const Team &other, vector<Player *> &all_players);
     int getTeamNumber() { return team_number; }
     bool isAlive();
     bool isSkipping();
@@ -499,11 +612,25 @@ class Team {
     Player *getNextAlivePlayer();
     Player *getAndSetNextAlivePlayer();
     Player *getCurrentPlayer() { return current_player; }
+    int getCurrentPlayerIndex() { return current_player_index; }
+    void restoreCursor(int index);
+    vector<Player *> &getPlayers() { return players; }
 };
 
 Team::Team(int team_number) : team_number(team_number), current_player_index(0), current_player(nullptr) {
 }
 
+/* copies turn order onto all_players, which is indexed by player number - 1 */
+Team::Team(const Team &other, vector<Player *> &all_players)
+    : team_number(other.team_number), current_player_index(other.current_player_index), current_player(nullptr) {
+    for (auto &player : other.players) {
+        players.push_back(all_players[player->getPlayerNumber() - 1]);
+    }
+    if (other.current_player != nullptr) {
+        current_player = players[current_player_index];
+    }
+}
+
 bool Team::isAlive() {
     for (auto &player : players) {
         if (player->isAlive()) {
@@ -526,6 +653,12 @@ void Team::skip() {
     }
 }
 
+/* index -1 puts the team back before its first turn */
+void Team::restoreCursor(int index) {
+    current_player_index = index < 0 ? 0 : index;
+    current_player = index < 0 ? nullptr : players[index];
+}
+
 int Team::getPlayersAliveCount() {
     int result = 0;
     for (auto &player : players) {
@@ -0,0 +1,707 @@
+#pragma once
+#ifndef CORO_HPP
+#define CORO_HPP
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mpscqueue.hpp"
+#include "timerwheel.hpp"
+#include "trace.hpp"
+
+using namespace std;
+
+/* needs -std=c++20, everything here runs on the thread calling Scheduler::run unless said otherwise */
+
+template <typename T>
+class Task;
+
+struct TaskPromiseBase {
+    coroutine_handle<> continuation;
+    exception_ptr exception;
+    // resumes whoever awaited the task directly instead of growing the stack
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        coroutine_handle<> await_suspend(coroutine_handle<Promise> handle) noexcept {
+            coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    optional<T> value;
+    Task<T> get_return_object();
+    void return_value(T new_value) { value = move(new_value); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+/**
+ * lazy coroutine, starts once awaited and hands back its value or exception to the awaiting coroutine
+ * the frame is destroyed with the Task
+ */
+template <typename T = void>
+class Task {
+   public:
+    using promise_type = TaskPromise<T>;
+
+   private:
+    coroutine_handle<promise_type> handle;
+
+   public:
+    explicit Task(coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task &&other) noexcept : handle(exchange(other.handle, nullptr)) {}
+    Task(const Task &other) = delete;
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+    bool await_ready() { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() {
+        if (handle.promise().exception) rethrow_exception(handle.promise().exception);
+        if constexpr (!is_void_v<T>) return move(*handle.promise().value);
+    }
+};
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+/**
+ * single threaded event loop, suspended coroutines cost only their frames
+ * run() must be called on the thread that created the scheduler
+ * fd watches and timers are one-shot, post() is the only call safe from other threads
+ * posted callbacks cross threads through a lock-free queue, the loop thread runs them in batches
+ * timers live in a wheel with 10ms ticks since every prompt arms one
+ */
+class Scheduler {
+   private:
+    // owns a spawned task, destroys itself once the task finishes
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() { return Detached{coroutine_handle<promise_type>::from_promise(*this)}; }
+            suspend_always initial_suspend() noexcept { return {}; }
+            suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { terminate(); }
+        };
+        coroutine_handle<promise_type> handle;
+    };
+    struct Watch {
+        int id;
+        function<void()> callback;
+    };
+    deque<coroutine_handle<>> ready;
+    // pollfds[0] is the posted queue's wake fd, pollfds[i + 1] belongs to watches[i], both kept in place between polls
+    vector<pollfd> pollfds;
+    vector<Watch> watches;
+    unordered_map<int, size_t> watch_indices;  // by id, so a watch is cancelled without a search
+    int next_watch_id = 0;
+    TimerWheel timers;
+    size_t live_tasks = 0;
+    bool stopped = false;
+    thread::id owner;
+    MpscQueue<function<void()>> posted;
+    vector<function<void()>> owner_posted;  // posted from the loop thread itself, which must never wait for room
+    vector<function<void()>> batch;
+    Detached runDetached(Task<void> task);
+    function<void()> removeWatch(size_t index);
+    void runPosted();
+    int getPollTimeout();
+
+   public:
+    typedef chrono::steady_clock::time_point Deadline;
+    /* resumes with false if deadline came first */
+    struct FdAwaiter {
+        Scheduler *scheduler;
+        int fd;
+        short events;
+        Deadline deadline;
+        bool ready = true;
+        bool await_ready() { return false; }
+        void await_suspend(coroutine_handle<> handle);
+        bool await_resume() { return ready; }
+    };
+    static const size_t MAX_POSTED = 1024;
+    static const size_t POSTED_BATCH = 64;  // callbacks run per loop iteration before fds get a turn
+    Scheduler() : timers(chrono::milliseconds(10)), owner(this_thread::get_id()), posted(MAX_POSTED) {
+        pollfds.push_back(pollfd{posted.getWakeFd(), POLLIN, 0});
+    }
+    Scheduler(const Scheduler &other) = delete;
+    void spawn(Task<void> task);
+    void resume(coroutine_handle<> handle) { ready.push_back(handle); }
+    int watch(int fd, short events, function<void()> callback);
+    void cancelWatch(int id);
+    TimerWheel::Id addTimer(Deadline time, function<void()> callback) { return timers.add(time, callback); }
+    void cancelTimer(TimerWheel::Id id) { timers.cancel(id); }
+    void post(function<void()> callback);
+    FdAwaiter readable(int fd, Deadline deadline = Deadline::max()) { return FdAwaiter{this, fd, POLLIN, deadline}; }
+    FdAwaiter writable(int fd, Deadline deadline = Deadline::max()) { return FdAwaiter{this, fd, POLLOUT, deadline}; }
+    void run();
+    /* run() returns after the current step, unfinished tasks stay suspended */
+    void stop() { stopped = true; }
+};
+
+Scheduler::Detached Scheduler::runDetached(Task<void> task) {
+    try {
+        co_await task;
+    } catch (exception &error) {
+        cerr << "Task failed: " << error.what() << endl;
+    }
+    --live_tasks;
+}
+
+/* starts task on the next loop iteration, run() keeps going while any spawned task is unfinished */
+void Scheduler::spawn(Task<void> task) {
+    ++live_tasks;
+    ready.push_back(runDetached(move(task)).handle);
+}
+
+void Scheduler::FdAwaiter::await_suspend(coroutine_handle<> handle) {
+    Scheduler *owner = scheduler;
+    if (deadline == Deadline::max()) {
+        scheduler->watch(fd, events, [owner, handle]() { owner->resume(handle); });
+        return;
+    }
+    // whichever of the two comes first cancels the other
+    shared_ptr<TimerWheel::Id> timer_id = make_shared<TimerWheel::Id>();
+    int watch_id = scheduler->watch(fd, events, [owner, handle, timer_id]() {
+        owner->cancelTimer(*timer_id);
+        owner->resume(handle);
+    });
+    *timer_id = scheduler->addTimer(deadline, [this, owner, handle, watch_id]() {
+        ready = false;
+        owner->cancelWatch(watch_id);
+        owner->resume(handle);
+    });
+}
+
+/* @return an id for cancelWatch */
+int Scheduler::watch(int fd, short events, function<void()> callback) {
+    watch_indices[next_watch_id] = watches.size();
+    watches.push_back(Watch{next_watch_id, move(callback)});
+    pollfds.push_back(pollfd{fd, events, 0});
+    return next_watch_id++;
+}
+
+void Scheduler::cancelWatch(int id) {
+    auto found = watch_indices.find(id);
+    if (found != watch_indices.end()) removeWatch(found->second);
+}
+
+/* moves the last watch into index, its revents go with it, @return the removed watch's callback */
+function<void()> Scheduler::removeWatch(size_t index) {
+    function<void()> callback = move(watches[index].callback);
+    watch_indices.erase(watches[index].id);
+    if (index + 1 != watches.size()) {
+        watches[index] = move(watches.back());
+        pollfds[index + 1] = pollfds.back();
+        watch_indices[watches[index].id] = index;
+    }
+    watches.pop_back();
+    pollfds.pop_back();
+    return callback;
+}
+
+/**
+ * callback runs on the scheduler thread, safe to call from any thread
+ * other threads wait for room while the queue is full, it is drained every loop iteration
+ */
+void Scheduler::post(function<void()> callback) {
+    if (this_thread::get_id() == owner) {
+        owner_posted.push_back(move(callback));
+        return;
+    }
+    while (!posted.tryPush(callback)) {
+        this_thread::yield();
+    }
+}
+
+void Scheduler::runPosted() {
+    batch.clear();
+    posted.popBatch(batch, POSTED_BATCH);
+    // swapped out first since the callbacks may post again
+    vector<function<void()>> own;
+    own.swap(owner_posted);
+    for (auto &callback : batch) {
+        callback();
+    }
+    for (auto &callback : own) {
+        callback();
+    }
+}
+
+/* @return milliseconds until the timer wheel has work, -1 if there are no timers */
+int Scheduler::getPollTimeout() {
+    Deadline wake_up = timers.getNextWakeUp();
+    if (wake_up == Deadline::max()) return -1;
+    auto wait = chrono::ceil<chrono::milliseconds>(wake_up - chrono::steady_clock::now()).count();
+    return wait < 0 ? 0 : (int)wait;
+}
+
+void Scheduler::run() {
+    TRACE_NAME_TRACK(nullptr, "scheduler");
+    vector<function<void()>> triggered;
+    while (live_tasks > 0 && !stopped) {
+        while (!ready.empty() && !stopped) {
+            coroutine_handle<> handle = ready.front();
+            ready.pop_front();
+            handle.resume();
+        }
+        if (live_tasks == 0 || stopped) break;
+
+        // only blocks when nothing is posted, producers then know to signal the wake fd
+        bool sleeping = owner_posted.empty() && posted.prepareSleep();
+        if (poll(pollfds.data(), pollfds.size(), sleeping ? getPollTimeout() : 0) < 0 && errno != EINTR) {
+            cerr << "poll failed." << endl;
+            return;
+        }
+        if (sleeping) posted.finishSleep();
+        runPosted();
+        // posted callbacks may have added watches, which start with no revents, or cancelled some since the poll
+        // going backwards, every watch moved into a removed one's place has already been looked at
+        triggered.clear();
+        for (size_t i = watches.size(); i-- > 0;) {
+            if (pollfds[i + 1].revents != 0) triggered.push_back(removeWatch(i));
+        }
+        // watches added by the callbacks below are polled next time
+        for (auto &callback : triggered) {
+            callback();
+        }
+        timers.advance(chrono::steady_clock::now());
+    }
+}
+
+/**
+ * line based connection to a player, either a non-blocking socket or the server console
+ * output is buffered and written whenever the socket accepts it, so a slow reader never blocks the loop
+ * the buffer holds at most capacity bytes, past that the connection is cut since nothing else can be done
+ * past the high watermark the reader is falling behind, the game decides whether to wait or to cut it
+ * a status frame still waiting to be sent is dropped once a newer one is written
+ */
+class Connection : public enable_shared_from_this<Connection> {
+   private:
+    class OutputBuffer : public streambuf {
+       private:
+        Connection *connection;
+
+       protected:
+        int overflow(int c) override {
+            if (c != traits_type::eof()) {
+                char byte = c;
+                connection->append(&byte, 1);
+            }
+            return c;
+        }
+        streamsize xsputn(const char *s, streamsize n) override {
+            connection->append(s, n);
+            return n;
+        }
+        int sync() override {
+            connection->flush();
+            return 0;
+        }
+
+       public:
+        OutputBuffer(Connection *connection) : connection(connection) {}
+    };
+    struct Segment {
+        string data;
+        bool status;
+    };
+    Scheduler *scheduler;
+    int fd;
+    bool console;
+    string input_buffer;
+    bool input_closed = false;
+    int late_answers = 0;        // lines still to come for prompts that timed out
+    bool discard_typed = false;  // the console has typed input left from a prompt that timed out
+    int hang_up_watch = -1;
+    deque<Segment> pending;  // the front one may be partly sent
+    size_t front_sent = 0;
+    size_t buffered = 0;  // bytes not yet sent
+    size_t high_watermark = 64 * 1024;
+    size_t capacity = 256 * 1024;
+    bool writing_status = false;
+    bool overflowed = false;
+    OutputBuffer output_streambuf;
+    ostream output;
+    int write_watch = -1;
+    bool closing = false;
+    bool close_timer_armed = false;
+    TimerWheel::Id close_timer = 0;
+    void append(const char *data, size_t size);
+    void flush();
+    void forceClose();
+
+   public:
+    enum ReadResult { LINE,
+                      CLOSED,
+                      TIMED_OUT };
+    static constexpr chrono::seconds CLOSE_LIMIT = chrono::seconds(10);  // for the output left after close
+    /* takes ownership of a connected socket */
+    Connection(Scheduler *scheduler, int fd)
+        : scheduler(scheduler), fd(fd), console(false), output_streambuf(this), output(&output_streambuf) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    /* the server console, reads stdin and writes to cout */
+    Connection(Scheduler *scheduler)
+        : scheduler(scheduler), fd(STDIN_FILENO), console(true), output_streambuf(this), output(&output_streambuf) {}
+    Connection(const Connection &other) = delete;
+    ~Connection() {
+        if (!console && fd >= 0) ::close(fd);
+    }
+    bool isConsole() { return console; }
+    ostream *getOutput() { return console ? &cout : &output; }
+    void setLimits(size_t new_high_watermark, size_t new_capacity);
+    size_t getBuffered() { return buffered; }
+    bool isFallingBehind() { return buffered > high_watermark; }
+    void beginStatus();
+    void endStatus() { writing_status = false; }
+    Task<ReadResult> readLine(string &line, Scheduler::Deadline deadline = Scheduler::Deadline::max());
+    void expirePrompt();
+    bool readAvailable();
+    void watchHangUp(function<void()> on_hang_up);
+    void stopWatchingHangUp();
+    Task<bool> drain(Scheduler::Deadline deadline);
+    void close();
+};
+
+void Connection::setLimits(size_t new_high_watermark, size_t new_capacity) {
+    high_watermark = new_high_watermark;
+    capacity = new_capacity;
+}
+
+void Connection::append(const char *data, size_t size) {
+    if (overflowed || fd < 0) return;
+    if (buffered + size > capacity) {
+        // too far behind to catch up, reads report the connection as closed from now on
+        overflowed = true;
+        pending.clear();
+        buffered = front_sent = 0;
+        ::shutdown(fd, SHUT_RDWR);
+        return;
+    }
+    if (pending.empty() || pending.back().status != writing_status) {
+        pending.push_back(Segment{string(), writing_status});
+    }
+    pending.back().data.append(data, size);
+    buffered += size;
+}
+
+/* lines written until endStatus make up one status frame, replacing any unsent older one */
+void Connection::beginStatus() {
+    if (console) return;
+    for (size_t i = pending.size(); i-- > 0;) {
+        if (pending[i].status && !(i == 0 && front_sent > 0)) {
+            buffered -= pending[i].data.size();
+            pending.erase(pending.begin() + i);
+        }
+    }
+    writing_status = true;
+    pending.push_back(Segment{string(), true});
+}
+
+void Connection::flush() {
+    while (!pending.empty() && fd >= 0) {
+        Segment &front = pending.front();
+        if (front_sent == front.data.size()) {
+            pending.pop_front();
+            front_sent = 0;
+            continue;
+        }
+        ssize_t written = ::send(fd, front.data.data() + front_sent, front.data.size() - front_sent, MSG_NOSIGNAL);
+        if (written > 0) {
+            front_sent += written;
+            buffered -= written;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (write_watch < 0) {
+                shared_ptr<Connection> self = shared_from_this();
+                write_watch = scheduler->watch(fd, POLLOUT, [self]() {
+                    self->write_watch = -1;
+                    self->flush();
+                });
+            }
+            return;
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // peer is gone, the next read reports it
+            pending.clear();
+            buffered = front_sent = 0;
+        }
+    }
+    if (closing && fd >= 0) {
+        ::close(fd);
+        fd = -1;
+        if (close_timer_armed) scheduler->cancelTimer(close_timer);
+        close_timer_armed = false;
+    }
+}
+
+/* drops whatever is still unsent and closes now */
+void Connection::forceClose() {
+    if (fd < 0) return;
+    if (write_watch >= 0) scheduler->cancelWatch(write_watch);
+    write_watch = -1;
+    stopWatchingHangUp();
+    pending.clear();
+    buffered = front_sent = 0;
+    ::close(fd);
+    fd = -1;
+    close_timer_armed = false;
+}
+
+/**
+ * called when a read times out, so the answer to that prompt is not taken for the answer to the next one
+ * a client sends one line for every prompt, so its next line is dropped, whenever it comes
+ * the console has no such protocol, so whatever was typed before the next read is dropped instead
+ */
+void Connection::expirePrompt() {
+    if (console) {
+        input_buffer.clear();
+        discard_typed = true;
+    } else {
+        ++late_answers;
+    }
+}
+
+/* @return CLOSED once the other side has closed and every line was read, TIMED_OUT if no line came by deadline */
+Task<Connection::ReadResult> Connection::readLine(string &line, Scheduler::Deadline deadline) {
+    if (discard_typed) {
+        discard_typed = false;
+        char chunk[4096];
+        pollfd typed = {fd, POLLIN, 0};
+        while (!input_closed && poll(&typed, 1, 0) > 0) {
+            if (::read(fd, chunk, sizeof chunk) <= 0) input_closed = true;
+        }
+    }
+    for (;;) {
+        size_t end = input_buffer.find('\n');
+        if (end != string::npos || (input_closed && !input_buffer.empty())) {
+            line = input_buffer.substr(0, end);
+            input_buffer.erase(0, end == string::npos ? end : end + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (late_answers > 0) {
+                --late_answers;
+                continue;
+            }
+            co_return LINE;
+        }
+        if (input_closed || fd < 0) co_return CLOSED;
+        bool readable = co_await scheduler->readable(fd, deadline);
+        if (!readable) co_return TIMED_OUT;
+        char chunk[4096];
+        ssize_t count = ::read(fd, chunk, sizeof chunk);
+        if (count > 0) {
+            input_buffer.append(chunk, count);
+        } else if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            input_closed = true;
+        }
+    }
+}
+
+/* reads whatever has already arrived without waiting, @return true once the other side has closed */
+bool Connection::readAvailable() {
+    char chunk[4096];
+    while (!console && !input_closed && fd >= 0) {
+        ssize_t count = ::read(fd, chunk, sizeof chunk);
+        if (count > 0) {
+            input_buffer.append(chunk, count);
+        } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (count == 0 || errno != EINTR) {
+            input_closed = true;
+        }
+    }
+    return input_closed || fd < 0;
+}
+
+/**
+ * for a connection nothing reads from yet, such as one waiting in a lobby
+ * on_hang_up runs once the other side closes, unless stopWatchingHangUp is called first
+ */
+void Connection::watchHangUp(function<void()> on_hang_up) {
+    if (console || fd < 0) return;
+    shared_ptr<Connection> self = shared_from_this();
+    hang_up_watch = scheduler->watch(fd, POLLIN, [self, on_hang_up]() {
+        self->hang_up_watch = -1;
+        if (self->readAvailable()) {
+            on_hang_up();
+        } else {
+            self->watchHangUp(on_hang_up);
+        }
+    });
+}
+
+void Connection::stopWatchingHangUp() {
+    if (hang_up_watch < 0) return;
+    scheduler->cancelWatch(hang_up_watch);
+    hang_up_watch = -1;
+}
+
+/* @return true once the backlog is down to half the high watermark, false if that did not happen by deadline */
+Task<bool> Connection::drain(Scheduler::Deadline deadline) {
+    while (buffered > high_watermark / 2) {
+        if (fd < 0 || overflowed) co_return false;
+        // awaited into a local, g++ 12 miscompiles co_await in this condition
+        bool writable = co_await scheduler->writable(fd, deadline);
+        if (!writable) co_return false;
+        flush();
+    }
+    co_return true;
+}
+
+/* closes once the buffered output is written or after CLOSE_LIMIT, the console is left open */
+void Connection::close() {
+    if (console || closing) return;
+    closing = true;
+    flush();
+    if (fd < 0) return;
+    // a peer that never reads would otherwise keep the fd and its watch forever
+    shared_ptr<Connection> self = shared_from_this();
+    close_timer = scheduler->addTimer(chrono::steady_clock::now() + CLOSE_LIMIT, [self]() { self->forceClose(); });
+    close_timer_armed = true;
+}
+
+/* non-blocking listening socket */
+class Listener {
+   private:
+    Scheduler *scheduler;
+    int fd = -1;
+
+   public:
+    Listener(Scheduler *scheduler) : scheduler(scheduler) {}
+    Listener(const Listener &other) = delete;
+    ~Listener() { close(); }
+    bool open(int port, int backlog);
+    Task<int> accept();
+    void close();
+};
+
+/* @return false if the port could not be listened on */
+bool Listener::open(int port, int backlog) {
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = INADDR_ANY;
+    if (bind(fd, (sockaddr *)&address, sizeof address) < 0 || listen(fd, backlog) < 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/* @return a connected socket, -1 if the listener failed */
+Task<int> Listener::accept() {
+    for (;;) {
+        int connection_fd = ::accept(fd, nullptr, nullptr);
+        if (connection_fd >= 0) co_return connection_fd;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) co_return -1;
+        co_await scheduler->readable(fd);
+    }
+}
+
+void Listener::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+/**
+ * one-shot event that other threads can set, awaited with a deadline
+ * keep it in a shared_ptr, set() and the timer hold references until they run
+ */
+class Signal : public enable_shared_from_this<Signal> {
+   private:
+    Scheduler *scheduler;
+    bool is_set = false;
+    bool resumed = false;
+    coroutine_handle<> waiting;
+    TimerWheel::Id timer_id;
+    bool has_timer = false;
+    void wake();
+
+   public:
+    struct Awaiter {
+        shared_ptr<Signal> signal;
+        chrono::steady_clock::time_point deadline;
+        bool await_ready() { return signal->is_set; }
+        void await_suspend(coroutine_handle<> handle);
+        bool await_resume() { return signal->is_set; }
+    };
+    Signal(Scheduler *scheduler) : scheduler(scheduler) {}
+    void set();
+    /* resumes with true if the signal was set before deadline */
+    Awaiter waitUntil(chrono::steady_clock::time_point deadline) { return Awaiter{shared_from_this(), deadline}; }
+};
+
+void Signal::wake() {
+    if (has_timer) scheduler->cancelTimer(timer_id);
+    has_timer = false;
+    if (waiting && !resumed) {
+        resumed = true;
+        scheduler->resume(waiting);
+    }
+}
+
+/* safe to call from any thread */
+void Signal::set() {
+    shared_ptr<Signal> self = shared_from_this();
+    scheduler->post([self]() {
+        self->is_set = true;
+        self->wake();
+    });
+}
+
+void Signal::Awaiter::await_suspend(coroutine_handle<> handle) {
+    signal->waiting = handle;
+    if (deadline == Scheduler::Deadline::max()) return;
+    shared_ptr<Signal> self = signal;
+    signal->has_timer = true;
+    signal->timer_id = signal->scheduler->addTimer(deadline, [self]() {
+        self->has_timer = false;
+        self->wake();
+    });
+}
+
+#endif /* CORO_HPP */
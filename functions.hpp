@@ -6,19 +6,22 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include "trace.hpp"
 
 enum ClientActions { CLIENT_END,
                      CLIENT_OUTPUT,
                      CLIENT_INPUT };
 
-/* don't include \n in output */
+/* don't include \n in output, a nullptr output discards the line */
 void outputTo(std::ostream *output, std::string line = "") {
+    if (output == nullptr) return;
     if (output != &std::cout) *output << CLIENT_OUTPUT << std::endl;
     *output << line << std::endl;
 }
 
 /* output to all except 3rd param, don't include \n in output */
 void outputToAll(std::vector<std::ostream *> outputs, std::string line = "", std::ostream *except = nullptr) {
+    TRACE_SPAN("broadcast");
     for (std::ostream *output : outputs) {
         if (output != except) {
             outputTo(output, line);
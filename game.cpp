@@ -1,71 +1,75 @@
+#include <signal.h>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <typeinfo>
+#include "analysis.hpp"
 #include "chopsticks.hpp"
+#include "coro.hpp"
 #include "functions.hpp"
+#include "history.hpp"
 #include "socketstream/socketstream.hh"
 
 using namespace std;
 
-void runServer(string port) {
-    // check player number validity
-    int player_count;
-    for (;;) {
-        string players_argument;
-        cout << "How many players are there?" << endl;
-        getline(cin, players_argument);
-        if (isValidInt(players_argument)) {
-            player_count = stoi(players_argument);
-            if (2 <= player_count && player_count <= 6) {
-                break;
-            } else {
-                cout << "There must be 2 to 6 players in a game." << endl;
-            }
-        } else {
-            cout << "That is not a valid integer!" << endl;
-        }
-    }
+/**
+ * how long players get to answer, and what happens to a player who runs out of time on their turn
+ * how much output may wait for a player, and what happens to a player who reads too slowly
+ */
+struct ServerOptions {
+    enum TimeoutAction { SKIP,
+                         BOT,
+                         FORFEIT };
+    enum SlowReaderAction { PAUSE,
+                            DISCONNECT };
+    chrono::seconds action_limit = chrono::seconds(60);
+    chrono::seconds setup_limit = chrono::seconds(120);  // mechanics, class and group prompts
+    chrono::seconds lobby_limit = chrono::seconds(300);  // waiting for a dedicated match to fill
+    TimeoutAction on_timeout = SKIP;
+    size_t high_watermark = 64 * 1024;  // bytes waiting for a player before they are falling behind
+    size_t output_capacity = 256 * 1024;  // bytes waiting for a player before they are cut off
+    SlowReaderAction on_slow_reader = PAUSE;
+    string cache_path;  // position cache file shared with other servers, none if empty
+    uint64_t cache_megabytes = 64;
+    string book_path;  // opening book from makebook, none if empty
+    string history_path;  // finished matches are appended to it for matchstats, none if empty
+};
 
-    swoope::socketstream listeningSocket;
-    vector<swoope::socketstream> sockets(player_count);
-    // initialize input and output streams
-    vector<ostream *> outputs(player_count);
-    vector<istream *> inputs(player_count);
-    outputs[0] = &cout;
-    inputs[0] = &cin;
-    for (int i = 1; i < player_count; ++i) {
-        outputs[i] = &sockets[i];
-        inputs[i] = &sockets[i];
-    }
-    // initialize connections
-    listeningSocket.open(port, player_count);
-    for (int i = 1; i < player_count; ++i) {  // connect players
-        cout << "Waiting for Player " << (i + 1) << "\n";
-        listeningSocket.accept(sockets[i]);
-        outputTo(outputs[i], "Waiting for other players...");
-    }
-    outputToAll(outputs, "Players connected!");
-    outputToAll(outputs);
+/* thrown out of a match once a player's connection is gone */
+struct Disconnected {
+    int player_number;
+};
 
-    // ready
-    ifstream banner("banner.txt");
-    if (banner.is_open()) {
-        string line;
-        while (getline(banner, line)) {
-            outputToAll(outputs, line);
-        }
-        outputToAll(outputs);
-        banner.close();
-    } else {
-        outputToAll(outputs, "Chopsticks will now commence!");
+/* thrown when a player does not answer in time */
+struct TimedOut {
+    int player_number;
+};
+
+/* thrown when a player reads the game too slowly to be waited for */
+struct FellBehind {
+    int player_number;
+};
+
+/* asks the player for a line without blocking the other matches, an answer coming after deadline is dropped */
+Task<string> getlineFrom(Connection &connection, int player_number, Scheduler::Deadline deadline) {
+    if (!connection.isConsole()) *connection.getOutput() << CLIENT_INPUT << endl;
+    string line;
+    Connection::ReadResult result = co_await connection.readLine(line, deadline);
+    if (result == Connection::CLOSED) throw Disconnected{player_number};
+    if (result == Connection::TIMED_OUT) {
+        connection.expirePrompt();
+        throw TimedOut{player_number};
     }
+    co_return line;
+}
 
-    // show mechanics
+Task<void> showMechanics(ServerOptions &options, vector<shared_ptr<Connection>> &connections, vector<ostream *> &outputs) {
+    TRACE_SPAN_ON(&connections, "mechanics");
     outputToAll(outputs, "Please wait...");
-    for (int i = 0; i < player_count; ++i) {
+    for (size_t i = 0; i < connections.size(); ++i) {
         outputTo(outputs[i], "Show mechanics? (y/n) default: n");
-        istringstream strm(getlineFrom(inputs[i], outputs[i]));
+        istringstream strm(co_await getlineFrom(*connections[i], i + 1, chrono::steady_clock::now() + options.setup_limit));
         string answer;
         strm >> answer;
         if (answer == "y" || answer == "Y") {
@@ -82,21 +86,23 @@ void runServer(string port) {
         outputTo(outputs[i], "Please wait...");
     }
 
-    for (int i = 0; i < player_count; ++i) {
+    for (size_t i = 0; i < connections.size(); ++i) {
         string line = "You are player " + to_string(i + 1);
         outputTo(outputs[i], line);
         outputTo(outputs[i]);
     }
+}
 
-    // player class phase
+Task<void> chooseClasses(ServerOptions &options, vector<shared_ptr<Connection>> &connections, vector<ostream *> &outputs, vector<Player *> &players) {
+    TRACE_SPAN_ON(&connections, "class pick");
+    int player_count = connections.size();
     outputToAll(outputs, "Please wait for your turn...", outputs[0]);
     outputToAll(outputs, "", outputs[0]);
-    vector<Player *> players;
     for (int i = 0; i < player_count; ++i) {
         outputTo(outputs[i], "Which player class would you like to play?");
         outputTo(outputs[i], "Choose 1: Human || Alien || Zombie || Doggo");
 
-        string type = getlineFrom(inputs[i], outputs[i]);
+        string type = co_await getlineFrom(*connections[i], i + 1, chrono::steady_clock::now() + options.setup_limit);
         if (!isValidString(type, 1)) {
             outputTo(outputs[i], "Enter only one keyword.");
             --i;
@@ -105,16 +111,9 @@ void runServer(string port) {
         istringstream line(type);
         line >> type;
 
-        Player *new_player;
-        if (type == "Human" || type == "human" || type == "1") {
-            new_player = new Human(i + 1, outputs[i], inputs[i]);
-        } else if (type == "Alien" || type == "alien" || type == "2") {
-            new_player = new Alien(i + 1, outputs[i], inputs[i]);
-        } else if (type == "Zombie" || type == "zombie" || type == "3") {
-            new_player = new Zombie(i + 1, outputs[i], inputs[i]);
-        } else if (type == "Doggo" || type == "doggo" || type == "4") {
-            new_player = new Doggo(i + 1, outputs[i], inputs[i]);
-        } else {
+        // players only write through their output, their input is read by the match
+        Player *new_player = createPlayer(type, i + 1, outputs[i], nullptr);
+        if (new_player == nullptr) {
             outputTo(outputs[i], "Invalid keyword! Try again.");
             outputTo(outputs[i]);
             --i;
@@ -129,129 +128,230 @@ void runServer(string port) {
         outputTo(outputs[i], "You are of type " + players[i]->getName());
         outputTo(outputs[i]);
     }
+}
 
-    // grouping phase
-    vector<Team> teams;
+Task<void> chooseGroups(ServerOptions &options, vector<shared_ptr<Connection>> &connections, vector<ostream *> &outputs, vector<Player *> &players) {
+    TRACE_SPAN_ON(&connections, "grouping");
+    int player_count = connections.size();
     outputToAll(outputs, "Grouping phase.");
-    {
-        int team_count = 0;
-        int group_numbers[player_count];
-        int group_player_counts[player_count];
-        bool valid_group = false;
-        while (!valid_group) {
-            // set group:player_count all to 0
-            for (int i = 0; i < player_count; ++i) {
-                group_player_counts[i] = 0;
-            }
-            // get input
-            outputToAll(outputs, "Please wait for your turn...", outputs[0]);
-            for (int i = 0; i < player_count; ++i) {
-                string group_arg;
-                outputTo(outputs[i], "Enter group number [1 to " + to_string(player_count) + "].");
-                group_arg = getlineFrom(inputs[i], outputs[i]);
-                if (isValidInt(group_arg)) {
-                    int group = stoi(group_arg);
-                    if (1 <= group && group <= player_count) {
-                        group_numbers[i] = group;
-                        outputTo(outputs[i], "Please wait for other players to choose their group.");
-                    } else {
-                        outputTo(outputs[i], "Group number out of range.");
-                        --i;
-                    }
+    vector<int> group_numbers(player_count);
+    vector<int> group_player_counts(player_count);
+    bool valid_group = false;
+    while (!valid_group) {
+        // set group:player_count all to 0
+        for (int i = 0; i < player_count; ++i) {
+            group_player_counts[i] = 0;
+        }
+        // get input
+        outputToAll(outputs, "Please wait for your turn...", outputs[0]);
+        for (int i = 0; i < player_count; ++i) {
+            string group_arg;
+            outputTo(outputs[i], "Enter group number [1 to " + to_string(player_count) + "].");
+            group_arg = co_await getlineFrom(*connections[i], i + 1, chrono::steady_clock::now() + options.setup_limit);
+            if (isValidInt(group_arg)) {
+                int group = stoi(group_arg);
+                if (1 <= group && group <= player_count) {
+                    group_numbers[i] = group;
+                    outputTo(outputs[i], "Please wait for other players to choose their group.");
                 } else {
-                    outputTo(outputs[i], "Group number must be a valid integer.");
+                    outputTo(outputs[i], "Group number out of range.");
                     --i;
                 }
+            } else {
+                outputTo(outputs[i], "Group number must be a valid integer.");
+                --i;
             }
-            // check validity
-            int check = 0;
-            for (int i = 0; i < player_count; ++i) {
-                ++group_player_counts[group_numbers[i] - 1];
-            }
-            for (int i = 0; i < player_count && group_player_counts[i] != 0; ++i, team_count = i) {
-                check += group_player_counts[i];
-            }
-            valid_group = group_player_counts[0] != 0 && group_player_counts[1] != 0 && check == player_count;
-            if (!valid_group) outputToAll(outputs, "Invalid groupings made! Try again.");
-        }
-        // valid grouping, build teams
-        for (int i = 1; i <= team_count; ++i) {
-            Team new_team(i);
-            teams.push_back(new_team);
         }
+        // check validity
+        int check = 0;
         for (int i = 0; i < player_count; ++i) {
-            players[i]->setTeamNumber(group_numbers[i]);
-            teams[group_numbers[i] - 1].addPlayer(players[i]);
+            ++group_player_counts[group_numbers[i] - 1];
+        }
+        for (int i = 0; i < player_count && group_player_counts[i] != 0; ++i) {
+            check += group_player_counts[i];
         }
+        valid_group = group_player_counts[0] != 0 && group_player_counts[1] != 0 && check == player_count;
+        if (!valid_group) outputToAll(outputs, "Invalid groupings made! Try again.");
+    }
+    // valid grouping, teams are built by the match
+    for (int i = 0; i < player_count; ++i) {
+        players[i]->setTeamNumber(group_numbers[i]);
     }
     outputToAll(outputs, "Grouping successful!");
     for (int i = 0; i < player_count; ++i) {
         outputTo(outputs[i], "You are in group " + to_string(players[i]->getTeamNumber()) + ".");
     }
     outputToAll(outputs);
+}
 
-    // actual game
-    Team *winning_team = nullptr;
-    for (unsigned int teams_alive = 0, current_team_index = 0; teams_alive != 1; current_team_index = (current_team_index + 1) % teams.size()) {
-        Team *current_team = &teams[current_team_index];
-        if (!current_team->isAlive()) continue;
-        // output game status
-        for (size_t i = 0; i < teams.size(); ++i) {
-            outputToAll(outputs, (i == current_team_index ? '>' : ' ') + teams[i].getStatus());
-        }
-        outputToAll(outputs);
+/* waits for the hint without holding up the scheduler */
+Task<string> getHint(Scheduler &scheduler, HintSession &hint_session) {
+    shared_ptr<AnalysisRequest> request = hint_session.request();
+    if (request != nullptr) {
+        shared_ptr<Signal> finished = make_shared<Signal>(&scheduler);
+        request->notify([finished]() { finished->set(); });
+        co_await finished->waitUntil(request->deadline + chrono::milliseconds(50));
+    }
+    co_return hint_session.takeResult();
+}
 
-        if (current_team->isSkipping()) {
-            current_team->skip();
-            outputToAll(outputs, "Team " + to_string(current_team->getTeamNumber()) + " has been skipped.");
-            outputToAll(outputs);
-            continue;
+/* a move for a player who ran out of time, the first legal one if the search finds nothing */
+Task<Move> getBotMove(Scheduler &scheduler, AnalysisPool &analysis_pool, Match &match, chrono::milliseconds time_limit) {
+    int team_number = match.getCurrentPlayer()->getTeamNumber();
+    shared_ptr<AnalysisRequest> request = make_shared<AnalysisRequest>(new Match(match), team_number, chrono::steady_clock::now() + time_limit);
+    if (analysis_pool.submit(request)) {
+        shared_ptr<Signal> finished = make_shared<Signal>(&scheduler);
+        request->notify([finished]() { finished->set(); });
+        bool is_finished = co_await finished->waitUntil(request->deadline + chrono::milliseconds(50));
+        if (is_finished) {
+            lock_guard<mutex> guard(request->lock);
+            if (request->result.has_move) co_return request->result.best_move;
         }
+        request->cancelled = true;
+    }
+    co_return match.getLegalMoves()[0];
+}
 
-        bool a_player_skipped = false;
-        Player *current_player = current_team->getAndSetNextAlivePlayer();
-        while (current_player->isSkipping() || !current_player->canMakeAnAction()) {
-            a_player_skipped = true;
-            if (current_player->canMakeAnAction()) {
-                outputToAll(outputs, "Player " + to_string(current_player->getPlayerNumber()) + " has been skipped.");
-            } else {
-                outputToAll(outputs, "Player " + to_string(current_player->getPlayerNumber()) + " can't make any action and has been skipped.");
-            }
-            current_player->hasBeenSkipped();
-            current_player = current_team->getAndSetNextAlivePlayer();
-        }
+/**
+ * players whose output is piling up are either cut off or, with PAUSE, left behind while the others play on
+ * status frames they have not started receiving are replaced by newer ones, and their own turn waits up to the action limit for them
+ */
+Task<void> waitForSlowReaders(ServerOptions &options, vector<shared_ptr<Connection>> &connections, vector<ostream *> &outputs, int player_index) {
+    for (size_t i = 0; i < connections.size(); ++i) {
+        if (!connections[i]->isFallingBehind()) continue;
+        if (options.on_slow_reader == ServerOptions::DISCONNECT) throw FellBehind{(int)i + 1};
+    }
+    if (!connections[player_index]->isFallingBehind()) co_return;
+    outputToAll(outputs, "Waiting for player " + to_string(player_index + 1) + " to catch up...", outputs[player_index]);
+    bool caught_up = co_await connections[player_index]->drain(chrono::steady_clock::now() + options.action_limit);
+    if (!caught_up) throw FellBehind{player_index + 1};
+}
 
-        if (a_player_skipped) {
-            outputToAll(outputs);
-            for (size_t i = 0; i < teams.size(); ++i) {
-                if (i == current_team_index) {
-                    outputToAll(outputs, '>' + teams[i].getCurrentStatus());
-                } else {
-                    outputToAll(outputs, ' ' + teams[i].getStatus());
-                }
-            }
-            outputToAll(outputs);
+/* game status, a status frame a player has not started receiving yet is replaced by this one */
+void outputStatus(vector<shared_ptr<Connection>> &connections, vector<ostream *> &outputs, Match &match) {
+    TRACE_SPAN("status");
+    vector<Team> &teams = match.getTeams();
+    for (auto &connection : connections) {
+        connection->beginStatus();
+    }
+    for (size_t i = 0; i < teams.size(); ++i) {
+        if (i == match.getCurrentTeamIndex() && match.getCurrentPlayer() != nullptr) {
+            outputToAll(outputs, '>' + teams[i].getCurrentStatus());
+        } else {
+            outputToAll(outputs, (match.getCurrentPlayer() != nullptr ? " " : "") + teams[i].getStatus());
         }
+    }
+    outputToAll(outputs);
+    for (auto &connection : connections) {
+        connection->endStatus();
+    }
+}
+
+/* output skipped teams and players */
+void outputNotices(vector<ostream *> &outputs, Match &match) {
+    vector<string> &notices = match.getNotices();
+    for (auto &notice : notices) {
+        outputToAll(outputs, notice);
+    }
+    if (!notices.empty()) outputToAll(outputs);
+    notices.clear();
+}
+
+/* the legal move from before that leads to the current position, for actions typed by players */
+uint64_t getPackedMove(Match &match, Undo &before) {
+    Match replay(match);
+    replay.restore(before);
+    uint64_t after = match.hash();
+    Undo undo;
+    for (auto &move : replay.getLegalMoves()) {
+        replay.makeMove(move, undo);
+        bool found = replay.hash() == after;
+        replay.unmakeMove(undo);
+        if (found) return MatchSummary::packMove(move);
+    }
+    return MatchSummary::NO_OPENING;
+}
+
+/* summary gets the first action of the match, the rest of it is filled in by runMatch */
+Task<void> playTurns(Scheduler &scheduler, AnalysisPool &analysis_pool, ServerOptions &options, vector<shared_ptr<Connection>> &connections, vector<ostream *> &outputs, Match &match, MatchSummary &summary) {
+    vector<Player *> &players = match.getPlayers();
+    vector<Team> &teams = match.getTeams();
+    while (match.getCurrentPlayer() != nullptr) {
+        TRACE_SPAN_ON_ARG(&connections, "turn", "player", match.getCurrentPlayer()->getPlayerNumber());
+        co_await waitForSlowReaders(options, connections, outputs, match.getCurrentPlayer()->getPlayerNumber() - 1);
+        outputNotices(outputs, match);
+        outputStatus(connections, outputs, match);
 
         // do turn
+        Player *current_player = match.getCurrentPlayer();
+        Team *current_team = &teams[match.getCurrentTeamIndex()];
         int player_index = current_player->getPlayerNumber() - 1;
         outputToAll(outputs, "Waiting for player " + to_string(player_index + 1) + " from team " + to_string(current_team->getTeamNumber()) + ".", outputs[player_index]);
         vector<string> actions_made;
-        for (int i = 0; i < current_player->getTurns(); ++i) {
+        vector<uint64_t> packed_moves;  // of actions_made, only until the opening is known
+        vector<Undo> undos;  // position before each action of this turn
+        int turn = match.getTurnCount();
+        while (match.getCurrentPlayer() != nullptr && match.getTurnCount() == turn) {
+            undos.push_back(Undo());
+            match.save(undos.back());
+            // a hint still being analyzed is cancelled once the action is made
+            HintSession hint_session(&analysis_pool, [&match]() { return new Match(match); }, current_team->getTeamNumber(), chrono::milliseconds(2000));
+            vector<string> keywords = {"hint"};
+            bool can_take_back = current_player->getTurns() > 1;
+            if (can_take_back) keywords.push_back("takeback");
             // player move
-            actions_made.push_back(current_player->playWith(players));
-            // check win
-            teams_alive = 0;
-            for (auto &team : teams) {
-                if (team.isAlive()) {
-                    ++teams_alive;
-                    winning_team = &team;
+            bool timed_out = false;
+            // hints, takebacks and invalid lines don't give the player more time
+            Scheduler::Deadline deadline = chrono::steady_clock::now() + options.action_limit;
+            for (;;) {
+                outputTo(outputs[player_index], current_player->getPrompt(keywords));
+                string line;
+                try {
+                    line = co_await getlineFrom(*connections[player_index], player_index + 1, deadline);
+                } catch (TimedOut &) {
+                    timed_out = true;
+                    break;
+                }
+                string keyword;
+                istringstream(line) >> keyword;
+                if (keyword == "hint") {
+                    outputTo(outputs[player_index], co_await getHint(scheduler, hint_session));
+                } else if (keyword == "takeback" && can_take_back) {
+                    if (actions_made.empty()) {
+                        outputTo(outputs[player_index], "There is no action to take back.");
+                        continue;
+                    }
+                    undos.pop_back();
+                    match.restore(undos.back());
+                    actions_made.pop_back();
+                    if (!packed_moves.empty()) packed_moves.pop_back();
+                    hint_session.cancel();
+                    outputTo(outputs[player_index], "Your last action has been taken back.");
+                } else if (current_player->playLine(players, line)) {
+                    actions_made.push_back(line);
+                    break;
                 }
-                if (teams_alive >= 2) break;
             }
-            if (teams_alive == 1) break;
+            if (!timed_out) {
+                match.endAction();
+                if (summary.opening == MatchSummary::NO_OPENING) packed_moves.push_back(getPackedMove(match, undos.back()));
+                continue;
+            }
+            outputTo(outputs[player_index], "You ran out of time.");
+            if (options.on_timeout == ServerOptions::BOT) {
+                Move move = co_await getBotMove(scheduler, analysis_pool, match, chrono::milliseconds(500));
+                outputTo(outputs[player_index], "A bot played " + move.toString() + " for you.");
+                actions_made.push_back(move.toString());
+                if (summary.opening == MatchSummary::NO_OPENING) packed_moves.push_back(MatchSummary::packMove(move));
+                match.play(move);
+            } else if (options.on_timeout == ServerOptions::FORFEIT) {
+                match.forfeit();
+            } else {
+                match.skipTurn();
+            }
         }
 
+        if (summary.opening == MatchSummary::NO_OPENING && !packed_moves.empty()) summary.opening = packed_moves[0];
         // broadcast moves made
         outputToAll(outputs, "Player " + to_string(player_index + 1) + " actions:", outputs[player_index]);
         for (auto &&action : actions_made) {
@@ -259,33 +359,272 @@ void runServer(string port) {
         }
         outputToAll(outputs);
     }
+    outputNotices(outputs, match);
     // output final game status
-    for (auto &team : teams) {
-        outputToAll(outputs, team.getStatus());
+    outputStatus(connections, outputs, match);
+    // game conclusion
+    Team *winning_team = match.getWinningTeam();
+    if (winning_team == nullptr) {
+        outputToAll(outputs, "No team can make any action. The game is a draw.");
+    } else {
+        int winning_team_number = winning_team->getTeamNumber();
+        for (size_t i = 0; i < players.size(); ++i) {
+            if (players[i]->getTeamNumber() == winning_team_number) {
+                outputTo(outputs[i], "Congratulations! Team " + to_string(winning_team_number) + " wins!");
+            } else {
+                outputTo(outputs[i], "You lose. Team " + to_string(winning_team_number) + " wins!");
+            }
+        }
     }
+}
+
+/* one whole game on already connected players, ends early if anyone disconnects, matches that got to play go to history */
+Task<void> runMatch(Scheduler &scheduler, AnalysisPool &analysis_pool, HistoryWriter *history, ServerOptions &options, vector<shared_ptr<Connection>> connections) {
+    // every phase gets connections, so its address is the match's track
+    TRACE_NAME_TRACK(&connections, "match");
+    TRACE_SPAN_ON(&connections, "match");
+    vector<ostream *> outputs;
+    for (auto &connection : connections) {
+        outputs.push_back(connection->getOutput());
+    }
+    outputToAll(outputs, "Players connected!");
     outputToAll(outputs);
-    // game conclusion
-    int winning_team_number = winning_team->getTeamNumber();
-    for (int i = 0; i < player_count; ++i) {
-        if (players[i]->getTeamNumber() == winning_team_number) {
-            outputTo(outputs[i], "Congratulations! Team " + to_string(winning_team_number) + " wins!");
-        } else {
-            outputTo(outputs[i], "You lose. Team " + to_string(winning_team_number) + " wins!");
+
+    // ready
+    ifstream banner("banner.txt");
+    if (banner.is_open()) {
+        string line;
+        while (getline(banner, line)) {
+            outputToAll(outputs, line);
+        }
+        outputToAll(outputs);
+        banner.close();
+    } else {
+        outputToAll(outputs, "Chopsticks will now commence!");
+    }
+
+    vector<Player *> players;
+    Match *match = nullptr;  // owns the players once created
+    MatchSummary summary;
+    auto started_at = chrono::steady_clock::now();
+    try {
+        co_await showMechanics(options, connections, outputs);
+        co_await chooseClasses(options, connections, outputs, players);
+        co_await chooseGroups(options, connections, outputs, players);
+        match = new Match(players, true);
+        started_at = chrono::steady_clock::now();
+        co_await playTurns(scheduler, analysis_pool, options, connections, outputs, *match, summary);
+    } catch (Disconnected &disconnected) {
+        summary.ending = MatchSummary::DISCONNECTED;
+        outputs[disconnected.player_number - 1] = nullptr;
+        outputToAll(outputs, "Player " + to_string(disconnected.player_number) + " disconnected. The match has ended.");
+    } catch (TimedOut &timed_out) {
+        summary.ending = MatchSummary::TIMED_OUT;
+        // an idle connection is as good as gone, evict it
+        outputToAll(outputs, "Player " + to_string(timed_out.player_number) + " took too long to answer. The match has ended.");
+    } catch (FellBehind &fell_behind) {
+        summary.ending = MatchSummary::FELL_BEHIND;
+        outputs[fell_behind.player_number - 1] = nullptr;
+        outputToAll(outputs, "Player " + to_string(fell_behind.player_number) + " fell too far behind. The match has ended.");
+    }
+    if (match == nullptr) {
+        for (auto &player : players) {
+            delete player;
         }
+    } else if (history != nullptr) {
+        summary.finished_at = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+        summary.duration = chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() - started_at).count();
+        summary.player_count = match->getPlayers().size();
+        summary.lineup = MatchSummary::packLineup(match->getPlayers());
+        Team *winning_team = summary.ending == MatchSummary::FINISHED ? match->getWinningTeam() : nullptr;
+        summary.winning_team = winning_team == nullptr ? 0 : winning_team->getTeamNumber();
+        summary.turns = match->getTurnCount();
+        summary.skips = match->getSkipCount();
+        history->add(summary);
     }
+    delete match;
     // close clients
-    for (int i = 1; i < player_count; ++i) {
-        *outputs[i] << CLIENT_END;
-        sockets[i].close();
+    for (size_t i = 0; i < connections.size(); ++i) {
+        if (outputs[i] != nullptr && !connections[i]->isConsole()) *outputs[i] << CLIENT_END << endl;
+        connections[i]->close();
+    }
+}
+
+/* the console is player 1, the others connect to port */
+Task<void> hostMatch(Scheduler &scheduler, AnalysisPool &analysis_pool, HistoryWriter *history, ServerOptions &options, int port) {
+    shared_ptr<Connection> console = make_shared<Connection>(&scheduler);
+    // check player number validity
+    int player_count;
+    for (;;) {
+        string players_argument;
+        cout << "How many players are there?" << endl;
+        Connection::ReadResult result = co_await console->readLine(players_argument);
+        if (result != Connection::LINE) co_return;
+        if (isValidInt(players_argument)) {
+            player_count = stoi(players_argument);
+            if (2 <= player_count && player_count <= 6) {
+                break;
+            } else {
+                cout << "There must be 2 to 6 players in a game." << endl;
+            }
+        } else {
+            cout << "That is not a valid integer!" << endl;
+        }
     }
-    // clean up
-    for (auto &player_ptr : players) {
-        delete player_ptr;
+
+    // initialize connections
+    Listener listener(&scheduler);
+    if (!listener.open(port, player_count)) {
+        cerr << "Unable to listen on port " << port << "." << endl;
+        co_return;
     }
-    listeningSocket.close();
+    vector<shared_ptr<Connection>> connections = {console};
+    TRACE_NAME_TRACK(&listener, "accept");
+    for (int i = 1; i < player_count; ++i) {  // connect players
+        TRACE_SPAN_ON(&listener, "accept");
+        cout << "Waiting for Player " << (i + 1) << "\n";
+        int fd = co_await listener.accept();
+        if (fd < 0) co_return;
+        connections.push_back(make_shared<Connection>(&scheduler, fd));
+        connections.back()->setLimits(options.high_watermark, options.output_capacity);
+        outputTo(connections.back()->getOutput(), "Waiting for other players...");
+    }
+    listener.close();
+    co_await runMatch(scheduler, analysis_pool, history, options, connections);
     cout << "Connections closed." << endl;
 }
 
+/**
+ * every player_count connections start their own match, runs until the listener fails
+ * connections left waiting longer than the lobby limit are evicted
+ */
+Task<void> serveMatches(Scheduler &scheduler, AnalysisPool &analysis_pool, HistoryWriter *history, ServerOptions &options, int player_count, int port) {
+    Listener listener(&scheduler);
+    if (!listener.open(port, 64)) {
+        cerr << "Unable to listen on port " << port << "." << endl;
+        co_return;
+    }
+    cout << "Serving " << player_count << " player matches on port " << port << "." << endl;
+    vector<pair<shared_ptr<Connection>, TimerWheel::Id>> lobby;
+    TRACE_NAME_TRACK(&listener, "accept");
+    for (;;) {
+        TRACE_SPAN_ON(&listener, "accept");
+        int fd = co_await listener.accept();
+        if (fd < 0) break;
+        shared_ptr<Connection> connection = make_shared<Connection>(&scheduler, fd);
+        connection->setLimits(options.high_watermark, options.output_capacity);
+        outputTo(connection->getOutput(), "Waiting for other players...");
+        TimerWheel::Id timer_id = scheduler.addTimer(chrono::steady_clock::now() + options.lobby_limit, [&lobby, connection]() {
+            for (size_t i = 0; i < lobby.size(); ++i) {
+                if (lobby[i].first == connection) {
+                    lobby.erase(lobby.begin() + i);
+                    break;
+                }
+            }
+            connection->stopWatchingHangUp();
+            outputTo(connection->getOutput(), "No match was found in time.");
+            *connection->getOutput() << CLIENT_END << endl;
+            connection->close();
+        });
+        // a player who leaves while waiting gives up their place
+        connection->watchHangUp([&scheduler, &lobby, connection]() {
+            for (size_t i = 0; i < lobby.size(); ++i) {
+                if (lobby[i].first != connection) continue;
+                scheduler.cancelTimer(lobby[i].second);
+                lobby.erase(lobby.begin() + i);
+                break;
+            }
+            connection->close();
+        });
+        lobby.push_back(make_pair(connection, timer_id));
+        if ((int)lobby.size() == player_count) {
+            // hang ups that came in since the last poll have not been seen yet
+            for (size_t i = lobby.size(); i-- > 0;) {
+                if (!lobby[i].first->readAvailable()) continue;
+                scheduler.cancelTimer(lobby[i].second);
+                lobby[i].first->stopWatchingHangUp();
+                lobby[i].first->close();
+                lobby.erase(lobby.begin() + i);
+            }
+        }
+        if ((int)lobby.size() == player_count) {
+            vector<shared_ptr<Connection>> connections;
+            for (auto &waiting : lobby) {
+                scheduler.cancelTimer(waiting.second);
+                waiting.first->stopWatchingHangUp();
+                connections.push_back(waiting.first);
+            }
+            scheduler.spawn(runMatch(scheduler, analysis_pool, history, options, connections));
+            lobby.clear();
+        }
+    }
+    // the timers point into this frame
+    for (auto &waiting : lobby) {
+        scheduler.cancelTimer(waiting.second);
+        waiting.first->stopWatchingHangUp();
+        waiting.first->close();
+    }
+}
+
+/* runs server and sets stop once it is done */
+Task<void> serveUntilDone(Task<void> server, shared_ptr<Signal> stop) {
+    try {
+        co_await server;
+    } catch (exception &error) {
+        cerr << "Server failed: " << error.what() << endl;
+    }
+    stop->set();
+}
+
+/* stops the loop once the server is done or SIGINT or SIGTERM came, matches still running are abandoned */
+Task<void> stopWhenSet(Scheduler &scheduler, shared_ptr<Signal> stop) {
+    co_await stop->waitUntil(Scheduler::Deadline::max());
+    scheduler.stop();
+}
+
+/* matches written to history wait at most its max_delay, even when no more come in */
+void scheduleHistoryFlush(Scheduler &scheduler, HistoryWriter *history) {
+    scheduler.addTimer(history->flushIfDue(chrono::steady_clock::now()), [&scheduler, history]() {
+        scheduleHistoryFlush(scheduler, history);
+    });
+}
+
+/* with dedicated_player_count set nobody plays on the console and matches run side by side */
+void runServer(ServerOptions &options, int port, int dedicated_player_count = 0) {
+    // every thread started from here inherits the mask, so only signal_waiter takes these signals
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+    Scheduler scheduler;
+    shared_ptr<Signal> stop = make_shared<Signal>(&scheduler);
+    thread signal_waiter([&stop_signals, stop]() {
+        int number;
+        sigwait(&stop_signals, &number);
+        stop->set();
+    });
+    PositionCache cache(options.cache_path, options.cache_path.empty() ? 0 : options.cache_megabytes);
+    if (!options.cache_path.empty() && !cache.isOpen()) cerr << "Position cache " << options.cache_path << " could not be opened, searching without it." << endl;
+    OpeningBook book(options.book_path);
+    if (!options.book_path.empty() && !book.isOpen()) cerr << "Opening book " << options.book_path << " could not be opened, searching without it." << endl;
+    HistoryWriter history_writer(options.history_path);
+    HistoryWriter *history = options.history_path.empty() ? nullptr : &history_writer;
+    // workers hand their results back through the scheduler, so the pool goes first
+    AnalysisPool analysis_pool(max(1u, thread::hardware_concurrency() / 2), 12, &cache, &book);
+    if (history != nullptr) scheduleHistoryFlush(scheduler, history);
+    if (dedicated_player_count == 0) {
+        scheduler.spawn(serveUntilDone(hostMatch(scheduler, analysis_pool, history, options, port), stop));
+    } else {
+        scheduler.spawn(serveUntilDone(serveMatches(scheduler, analysis_pool, history, options, dedicated_player_count, port), stop));
+    }
+    scheduler.spawn(stopWhenSet(scheduler, stop));
+    scheduler.run();
+    // wakes signal_waiter if no signal came, its set() then goes unanswered
+    pthread_kill(signal_waiter.native_handle(), SIGTERM);
+    signal_waiter.join();
+}
+
 /* generic client, no logic */
 void runClient(string ip, string port) {
     swoope::socketstream server;
@@ -306,7 +645,11 @@ void runClient(string ip, string port) {
                 cout << line << endl;
                 break;
             case CLIENT_INPUT:
-                getline(cin, line);
+                // no more input, leave so the server can end the match
+                if (!getline(cin, line)) {
+                    running = false;
+                    break;
+                }
                 server << line << endl;
                 break;
             default:
@@ -317,15 +660,64 @@ void runClient(string ip, string port) {
     cout << "Connection closed." << endl;
 }
 
+/**
+ * server: game [options] <port>
+ * dedicated server: game [options] -d <players> <port>
+ * client: game <ip> <port>
+ * options: -t <seconds> to answer on a turn, -o skip|bot|forfeit for players who run out of time,
+ *          -b pause|disconnect for players who read too slowly,
+ *          -c <file> to keep what bot and hint searches found across matches and restarts,
+ *          -k <file> for an opening book made by makebook, -r <file> to record finished matches for matchstats
+ */
 int main(int argc, char *argv[]) {
+    // server options
+    ServerOptions options;
+    vector<string> arguments;
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "-t" && i + 1 < argc && isValidInt(argv[i + 1]) && stoi(argv[i + 1]) > 0) {
+            options.action_limit = chrono::seconds(stoi(argv[++i]));
+        } else if (argument == "-o" && i + 1 < argc) {
+            string action = argv[++i];
+            if (action == "skip") {
+                options.on_timeout = ServerOptions::SKIP;
+            } else if (action == "bot") {
+                options.on_timeout = ServerOptions::BOT;
+            } else if (action == "forfeit") {
+                options.on_timeout = ServerOptions::FORFEIT;
+            } else {
+                cerr << "Timeout action must be skip, bot or forfeit." << endl;
+                return 0;
+            }
+        } else if (argument == "-c" && i + 1 < argc) {
+            options.cache_path = argv[++i];
+        } else if (argument == "-k" && i + 1 < argc) {
+            options.book_path = argv[++i];
+        } else if (argument == "-r" && i + 1 < argc) {
+            options.history_path = argv[++i];
+        } else if (argument == "-b" && i + 1 < argc) {
+            string action = argv[++i];
+            if (action == "pause") {
+                options.on_slow_reader = ServerOptions::PAUSE;
+            } else if (action == "disconnect") {
+                options.on_slow_reader = ServerOptions::DISCONNECT;
+            } else {
+                cerr << "Slow reader action must be pause or disconnect." << endl;
+                return 0;
+            }
+        } else {
+            arguments.push_back(argument);
+        }
+    }
     // check port validity
-    if (!(argc == 2 || argc == 3)) {
+    bool dedicated = arguments.size() == 3 && arguments[0] == "-d";
+    if (!(arguments.size() == 1 || arguments.size() == 2 || dedicated)) {
         cerr << "Invalid argument count." << endl;
         return 0;
     }
-    int port_index = argc - 1;
-    if (isValidInt(argv[port_index])) {
-        int port = stoi(argv[port_index]);
+    string port_argument = arguments.back();
+    if (isValidInt(port_argument)) {
+        int port = stoi(port_argument);
         if (!(1024 <= port && port <= 65535)) {
             cerr << "Port must be from 1024 to 65535 only." << endl;
             return 0;
@@ -334,11 +726,17 @@ int main(int argc, char *argv[]) {
         cerr << "Port must be an integer." << endl;
         return 0;
     }
+    if (dedicated && !(isValidInt(arguments[1]) && 2 <= stoi(arguments[1]) && stoi(arguments[1]) <= 6)) {
+        cerr << "There must be 2 to 6 players in a game." << endl;
+        return 0;
+    }
     // run
-    if (argc == 2) {
-        runServer(argv[1]);
-    } else if (argc == 3) {
-        runClient(argv[1], argv[2]);
+    if (dedicated) {
+        runServer(options, stoi(arguments[2]), stoi(arguments[1]));
+    } else if (arguments.size() == 1) {
+        runServer(options, stoi(arguments[0]));
+    } else if (arguments.size() == 2) {
+        runClient(arguments[0], arguments[1]);
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,282 @@
+#pragma once
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "match.hpp"
+
+using namespace std;
+
+/* one finished match, a row of the history */
+struct MatchSummary {
+    enum Ending { FINISHED,
+                  DISCONNECTED,
+                  TIMED_OUT,
+                  FELL_BEHIND };
+    static const uint32_t NO_OPENING = UINT32_MAX;
+    uint64_t finished_at = 0;  // seconds since the epoch
+    uint64_t duration = 0;     // seconds from the first prompt of the game to its end
+    uint64_t player_count = 0;
+    uint64_t lineup = 0;        // LINEUP_BITS per player in player order, see getClass and getGroup
+    uint64_t winning_team = 0;  // 0 for a draw or a match that did not finish
+    uint64_t ending = FINISHED;
+    uint64_t turns = 0;
+    uint64_t skips = 0;
+    uint64_t opening = NO_OPENING;  // first action of the match, see packMove
+    static const int LINEUP_BITS = 5;
+    static uint64_t packLineup(vector<Player *> &players);
+    static int getClass(uint64_t lineup, int player_index) { return (lineup >> (LINEUP_BITS * player_index + 3)) & 3; }
+    static int getGroup(uint64_t lineup, int player_index) { return (lineup >> (LINEUP_BITS * player_index)) & 7; }
+    static uint64_t packMove(Move &move);
+    static Move unpackMove(uint64_t packed);
+};
+
+/* class in the top 2 bits of a player's LINEUP_BITS and group in the bottom 3, a group of 0 is no player */
+uint64_t MatchSummary::packLineup(vector<Player *> &players) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < players.size(); ++i) {
+        result |= (uint64_t)((int)players[i]->getType() << 3 | players[i]->getTeamNumber()) << (LINEUP_BITS * i);
+    }
+    return result;
+}
+
+/* 3 bits per field that holds an extremity count or index, only the fields of the move's type are packed */
+uint64_t MatchSummary::packMove(Move &move) {
+    uint64_t result = (uint64_t)move.type | (uint64_t)move.mode << 1;
+    if (move.type == Move::TAP) {
+        return result | (uint64_t)(move.from & 7) << 2 | (uint64_t)(move.target_player & 7) << 5 | (uint64_t)move.target_mode << 8 | (uint64_t)(move.to & 7) << 9;
+    }
+    int counts_size = min(move.counts_size, MAX_EXTREMITIES);
+    result |= (uint64_t)counts_size << 12;
+    for (int i = 0; i < counts_size; ++i) {
+        result |= (uint64_t)(move.counts[i] & 7) << (15 + 3 * i);
+    }
+    return result;
+}
+
+Move MatchSummary::unpackMove(uint64_t packed) {
+    Move move;
+    move.type = (Move::Type)(packed & 1);
+    move.mode = (enum Extremity::Type)((packed >> 1) & 1);
+    move.from = (packed >> 2) & 7;
+    move.target_player = (packed >> 5) & 7;
+    move.target_mode = (enum Extremity::Type)((packed >> 8) & 1);
+    move.to = (packed >> 9) & 7;
+    // a corrupt file can't make toString read past counts
+    move.counts_size = min<int>((packed >> 12) & 7, MAX_EXTREMITIES);
+    for (int i = 0; i < move.counts_size; ++i) {
+        move.counts[i] = (packed >> (15 + 3 * i)) & 7;
+    }
+    return move;
+}
+
+/* the decoded rows of one block, a vector per column */
+struct HistoryBlock {
+    enum Column { FINISHED_AT,
+                  DURATION,
+                  PLAYER_COUNT,
+                  LINEUP,
+                  WINNING_TEAM,
+                  ENDING,
+                  TURNS,
+                  SKIPS,
+                  OPENING,
+                  COLUMN_COUNT };
+    static const uint32_t ALL_COLUMNS = (1 << COLUMN_COUNT) - 1;  // bit per column
+    size_t rows = 0;
+    vector<uint64_t> columns[COLUMN_COUNT];
+    static uint64_t MatchSummary::*getField(int column);
+};
+
+uint64_t MatchSummary::*HistoryBlock::getField(int column) {
+    static uint64_t MatchSummary::*fields[COLUMN_COUNT] = {
+        &MatchSummary::finished_at, &MatchSummary::duration, &MatchSummary::player_count, &MatchSummary::lineup, &MatchSummary::winning_team,
+        &MatchSummary::ending, &MatchSummary::turns, &MatchSummary::skips, &MatchSummary::opening};
+    return fields[column];
+}
+
+/**
+ * the history file is a list of blocks, each one written with a single append so several servers can share the file
+ * a block is "CHB1", its row count and its size, then every column on its own as an encoding, a size and the bytes
+ * columns are stored as runs of equal values or as zigzag varint deltas, whichever is smaller
+ */
+enum ColumnEncoding { RUNS,
+                      DELTAS };
+
+void putVarint(string &bytes, uint64_t value) {
+    while (value >= 0x80) {
+        bytes += (char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes += (char)value;
+}
+
+/* @return false if the varint runs past end */
+bool getVarint(const unsigned char *&position, const unsigned char *end, uint64_t &value) {
+    value = 0;
+    for (int shift = 0; position < end && shift < 64; shift += 7) {
+        unsigned char byte = *position++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) return true;
+    }
+    return false;
+}
+
+void putUint32(string &bytes, uint32_t value) {
+    bytes.append((const char *)&value, sizeof value);
+}
+
+uint32_t getUint32(const unsigned char *position) {
+    uint32_t value;
+    memcpy(&value, position, sizeof value);
+    return value;
+}
+
+string encodeColumn(const vector<uint64_t> &values) {
+    string runs, deltas;
+    for (size_t i = 0; i < values.size();) {
+        size_t end = i;
+        while (end < values.size() && values[end] == values[i]) ++end;
+        putVarint(runs, values[i]);
+        putVarint(runs, end - i);
+        i = end;
+    }
+    uint64_t previous = 0;
+    for (auto &value : values) {
+        int64_t delta = (int64_t)(value - previous);
+        putVarint(deltas, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        previous = value;
+    }
+    string result(1, (char)(runs.size() <= deltas.size() ? RUNS : DELTAS));
+    string &bytes = runs.size() <= deltas.size() ? runs : deltas;
+    putUint32(result, bytes.size());
+    return result + bytes;
+}
+
+/* @return false if the column is corrupt */
+bool decodeColumn(ColumnEncoding encoding, const unsigned char *position, const unsigned char *end, size_t rows, vector<uint64_t> &values) {
+    values.clear();
+    values.reserve(rows);
+    uint64_t value, count;
+    while (values.size() < rows) {
+        if (!getVarint(position, end, value)) return false;
+        if (encoding == RUNS) {
+            if (!getVarint(position, end, count) || count > rows - values.size()) return false;
+            values.insert(values.end(), count, value);
+        } else {
+            uint64_t previous = values.empty() ? 0 : values.back();
+            values.push_back(previous + ((value >> 1) ^ (~(value & 1) + 1)));
+        }
+    }
+    return position == end;
+}
+
+/* buffers finished matches and appends them a block at a time, an empty path writes nothing */
+class HistoryWriter {
+   private:
+    string path;
+    size_t block_rows;
+    chrono::steady_clock::duration max_delay;
+    chrono::steady_clock::time_point oldest;
+    vector<MatchSummary> pending;
+
+   public:
+    HistoryWriter(string path, size_t block_rows = 64, chrono::steady_clock::duration max_delay = chrono::minutes(5))
+        : path(path), block_rows(block_rows), max_delay(max_delay) {}
+    HistoryWriter(const HistoryWriter &other) = delete;
+    ~HistoryWriter() { flush(); }
+    void add(MatchSummary &summary);
+    chrono::steady_clock::time_point flushIfDue(chrono::steady_clock::time_point now);
+    bool flush();
+};
+
+/* writes once block_rows matches are pending, the owner calls flushIfDue for the ones that wait too long */
+void HistoryWriter::add(MatchSummary &summary) {
+    if (pending.empty()) oldest = chrono::steady_clock::now();
+    pending.push_back(summary);
+    if (pending.size() >= block_rows) flush();
+}
+
+/**
+ * writes if the oldest pending match has waited max_delay
+ * @return when to call again, a match added before then is not due until after it
+ */
+chrono::steady_clock::time_point HistoryWriter::flushIfDue(chrono::steady_clock::time_point now) {
+    if (!pending.empty() && now - oldest >= max_delay) flush();
+    return (pending.empty() ? now : oldest) + max_delay;
+}
+
+/* @return false if the block could not be appended, the rows are dropped either way */
+bool HistoryWriter::flush() {
+    if (pending.empty() || path.empty()) return true;
+    string payload;
+    vector<uint64_t> values;
+    for (int column = 0; column < HistoryBlock::COLUMN_COUNT; ++column) {
+        values.clear();
+        for (auto &summary : pending) {
+            values.push_back(summary.*HistoryBlock::getField(column));
+        }
+        payload += encodeColumn(values);
+    }
+    string block = "CHB1";
+    putUint32(block, pending.size());
+    putUint32(block, payload.size());
+    block += payload;
+    pending.clear();
+    int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    // one write per block, appends to a regular file are not interleaved with other writers
+    bool written = write(fd, block.data(), block.size()) == (ssize_t)block.size();
+    close(fd);
+    return written;
+}
+
+/* reads a history file block by block, stopping at the end or at a block cut short by a crash */
+class HistoryReader {
+   private:
+    ifstream file;
+    string payload;
+
+   public:
+    HistoryReader(string path) : file(path, ios::binary) {}
+    bool isOpen() { return file.is_open(); }
+    bool nextBlock(HistoryBlock &block, uint32_t columns = HistoryBlock::ALL_COLUMNS);
+};
+
+/**
+ * only the columns with their bit set are decoded, the others are skipped and left empty
+ * @return false once there is no complete block left
+ */
+bool HistoryReader::nextBlock(HistoryBlock &block, uint32_t columns) {
+    unsigned char header[12];
+    if (!file.read((char *)header, sizeof header) || memcmp(header, "CHB1", 4) != 0) return false;
+    block.rows = getUint32(header + 4);
+    payload.resize(getUint32(header + 8));
+    if (!file.read(&payload[0], payload.size())) return false;
+    const unsigned char *position = (const unsigned char *)payload.data();
+    const unsigned char *end = position + payload.size();
+    for (int column = 0; column < HistoryBlock::COLUMN_COUNT; ++column) {
+        if (end - position < 5) return false;
+        ColumnEncoding encoding = (ColumnEncoding)*position;
+        uint32_t size = getUint32(position + 1);
+        position += 5;
+        if ((uint64_t)(end - position) < size) return false;
+        if (!(columns & 1 << column)) {
+            block.columns[column].clear();
+        } else if (!decodeColumn(encoding, position, position + size, block.rows, block.columns[column])) {
+            return false;
+        }
+        position += size;
+    }
+    return true;
+}
+
+#endif /* HISTORY_HPP */
@@ -0,0 +1,163 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "match.hpp"
+#include "openingbook.hpp"
+#include "search.hpp"
+
+using namespace std;
+
+/**
+ * searches every position in the first few actions of every lineup and writes them as an opening book
+ * usage: makebook <file> [<class>:<group> ...] [-n max players] [-p plies] [-m milliseconds] [-j threads]
+ * example: makebook openings.book -n 3 -p 2 -m 500 -j 8
+ * without a lineup every class and group combination of 2 to max players is built, the count grows
+ * fast (about 19000 lineups of 4 players, 19 million of 6), so list the lineups played for larger games
+ * build: g++ -std=c++11 -O2 -pthread makebook.cpp -o makebook
+ */
+
+const char *CLASS_NAMES[] = {"human", "alien", "zombie", "doggo"};
+const int CLASS_COUNT = 4;
+
+/* every lineup of player_count players whose groups are 1 to n with at least two of them */
+void addLineups(int player_count, vector<vector<string>> &lineups) {
+    vector<int> classes(player_count, 0), groups(player_count, 1);
+    for (;;) {
+        // groups must be used without gaps
+        vector<bool> used(player_count + 1, false);
+        int highest = 0;
+        for (auto &group : groups) {
+            used[group] = true;
+            highest = max(highest, group);
+        }
+        bool valid = highest >= 2;
+        for (int group = 1; group <= highest && valid; ++group) {
+            valid = used[group];
+        }
+        if (valid) {
+            fill(classes.begin(), classes.end(), 0);
+            for (;;) {
+                vector<string> lineup;
+                for (int i = 0; i < player_count; ++i) {
+                    lineup.push_back(string(CLASS_NAMES[classes[i]]) + ":" + to_string(groups[i]));
+                }
+                lineups.push_back(lineup);
+                int i = 0;
+                while (i < player_count && ++classes[i] == CLASS_COUNT) classes[i++] = 0;
+                if (i == player_count) break;
+            }
+        }
+        int i = 0;
+        while (i < player_count && ++groups[i] > player_count) groups[i++] = 1;
+        if (i == player_count) break;
+    }
+}
+
+/* depth first through the first plies actions, searching every position not seen yet in this lineup */
+void addPositions(Match &match, int plies, chrono::milliseconds time_limit, set<uint64_t> &seen, vector<BookEntry> &entries) {
+    Player *current_player = match.getCurrentPlayer();
+    if (current_player == nullptr) return;
+    int team_number = current_player->getTeamNumber();
+    uint64_t key = match.hash() ^ Search::getLineupKey(match, team_number);
+    if (!seen.insert(key).second) return;
+    Search search(team_number, chrono::steady_clock::now() + time_limit);
+    SearchResult result = search.run(match);
+    vector<Move> moves = match.getLegalMoves();
+    if (result.has_move) {
+        for (size_t i = 0; i < moves.size(); ++i) {
+            if (moves[i].toString() != result.best_move.toString()) continue;
+            entries.push_back(BookEntry{key, result.score, (uint16_t)result.depth, (uint16_t)i});
+            break;
+        }
+    }
+    if (plies == 0) return;
+    Undo undo;
+    for (auto &move : moves) {
+        match.makeMove(move, undo);
+        addPositions(match, plies - 1, time_limit, seen, entries);
+        match.unmakeMove(undo);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: makebook <file> [<class>:<group> ...] [-n max players] [-p plies] [-m milliseconds] [-j threads]" << endl;
+        return 1;
+    }
+    string path = argv[1];
+    int max_players = 3;
+    int plies = 1;
+    int milliseconds = 200;
+    int threads = thread::hardware_concurrency();
+    vector<string> lineup;
+    for (int i = 2; i < argc; ++i) {
+        string argument = argv[i];
+        if ((argument == "-n" || argument == "-p" || argument == "-m" || argument == "-j") && i + 1 < argc && isValidInt(argv[i + 1])) {
+            int value = stoi(argv[++i]);
+            (argument == "-n" ? max_players : argument == "-p" ? plies : argument == "-m" ? milliseconds : threads) = value;
+        } else {
+            lineup.push_back(argument);
+        }
+    }
+    if (max_players < 2 || max_players > MAX_PLAYERS || plies < 0 || milliseconds < 1) {
+        cerr << "There must be 2 to 6 players, and plies and milliseconds can't be negative." << endl;
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+    vector<vector<string>> lineups;
+    if (!lineup.empty()) {
+        lineups.push_back(lineup);
+    } else {
+        for (int player_count = 2; player_count <= max_players; ++player_count) {
+            addLineups(player_count, lineups);
+        }
+    }
+    auto start = chrono::steady_clock::now();
+
+    // lineups are independent, so every thread takes whole lineups
+    atomic<size_t> next_lineup(0);
+    atomic<bool> invalid(false);
+    mutex entries_lock;
+    vector<BookEntry> entries;
+    vector<thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.push_back(thread([&]() {
+            for (size_t index = next_lineup++; index < lineups.size(); index = next_lineup++) {
+                vector<Player *> players;
+                if (!createLineup(lineups[index], players)) {
+                    invalid = true;
+                    return;
+                }
+                Match match(players);
+                set<uint64_t> seen;
+                vector<BookEntry> found;
+                addPositions(match, plies, chrono::milliseconds(milliseconds), seen, found);
+                lock_guard<mutex> guard(entries_lock);
+                entries.insert(entries.end(), found.begin(), found.end());
+            }
+        }));
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    if (invalid) {
+        cerr << "Invalid players or groups. There must be 2 to 6 players in groups 1 to n." << endl;
+        return 1;
+    }
+    if (!OpeningBook::write(path, entries)) {
+        cerr << "Could not write " << path << "." << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "Lineups: " << lineups.size() << endl;
+    cout << "Positions: " << entries.size() << endl;
+    cout << "Bytes: " << 16 + entries.size() * sizeof(BookEntry) << endl;
+    cout << "Time: " << seconds << "s" << endl;
+    return 0;
+}
@@ -0,0 +1,563 @@
+#pragma once
+#ifndef MATCH_HPP
+#define MATCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "chopsticks.hpp"
+
+using namespace std;
+
+const int MAX_PLAYERS = 6;
+const int MAX_EXTREMITIES = 4;  // of one type, for any player class
+
+/* a single action, the same as what a player types in Player::playWith */
+struct Move {
+    enum Type { TAP,
+                DISTRIBUTE };
+    Move::Type type = TAP;
+    enum Extremity::Type mode = Extremity::HAND;         // extremity used for tap, or extremities to redistribute
+    int from = 0;                                        // index of own extremity for tap
+    int target_player = 0;                               // player number for tap
+    enum Extremity::Type target_mode = Extremity::HAND;  // target extremity type for tap
+    int to = 0;                                          // index of target extremity for tap
+    int counts[MAX_EXTREMITIES] = {};                    // result of redistribution, dead extremities are 0
+    int counts_size = 0;
+    string toString();
+};
+
+string Move::toString() {
+    if (type == TAP) {
+        string result = "tap ";
+        result += (mode == Extremity::HAND ? 'H' : 'F');
+        result += (char)('A' + from);
+        result += " " + to_string(target_player) + " ";
+        result += (target_mode == Extremity::HAND ? 'H' : 'F');
+        result += (char)('A' + to);
+        return result;
+    }
+    string result = mode == Extremity::HAND ? "disthands" : "distfeet";
+    for (int i = 0; i < counts_size; ++i) {
+        result += " " + to_string(counts[i]);
+    }
+    return result;
+}
+
+/* enough of a position to put it back after makeMove or save, without allocating */
+struct Undo {
+    struct ExtremityState {
+        int8_t player_index;
+        int8_t mode;
+        int8_t index;
+        int8_t count;
+        bool alive;
+    };
+    ExtremityState extremities[MAX_PLAYERS * 2 * MAX_EXTREMITIES];
+    int extremities_size = 0;                // only the extremities that makeMove changes
+    uint8_t hands_sizes[MAX_PLAYERS];        // a zombie grows a hand when its starting hand dies
+    uint8_t alive_players = 0;               // bit per player index
+    uint8_t skipping_players = 0;            // bit per player index
+    int8_t team_cursors[MAX_PLAYERS];        // -1 before a team's first turn
+    int8_t current_team_index = 0;
+    bool started = false;
+    int8_t current_player_index = -1;
+    int8_t actions_left = 0;
+    int turn_count = 0;
+    int skip_count = 0;
+};
+
+/**
+ * builds silent players from <class>:<group> arguments such as human:1, with the same grouping rules as runServer
+ * @return true if every argument and the grouping are valid, else false and no players are made
+ */
+bool createLineup(vector<string> &arguments, vector<Player *> &players) {
+    vector<int> group_player_counts(MAX_PLAYERS, 0);
+    bool valid = arguments.size() >= 2 && arguments.size() <= MAX_PLAYERS;
+    for (size_t i = 0; i < arguments.size() && valid; ++i) {
+        size_t colon = arguments[i].find(':');
+        valid = colon != string::npos && isValidInt(arguments[i].substr(colon + 1));
+        if (!valid) break;
+        int group = stoi(arguments[i].substr(colon + 1));
+        Player *new_player = createPlayer(arguments[i].substr(0, colon), i + 1, nullptr, nullptr);
+        valid = new_player != nullptr && 1 <= group && group <= MAX_PLAYERS;
+        if (new_player == nullptr) break;
+        new_player->setTeamNumber(group);
+        players.push_back(new_player);
+        if (valid) ++group_player_counts[group - 1];
+    }
+    size_t check = 0;
+    for (size_t i = 0; i < group_player_counts.size() && group_player_counts[i] != 0; ++i) {
+        check += group_player_counts[i];
+    }
+    valid = valid && group_player_counts[0] != 0 && group_player_counts[1] != 0 && check == players.size();
+    if (!valid) {
+        for (auto &player : players) {
+            delete player;
+        }
+        players.clear();
+    }
+    return valid;
+}
+
+/**
+ * owns the players and teams of one game and follows the same turn order as runServer,
+ * so that positions can be copied, searched and played without any client
+ */
+class Match {
+   private:
+    vector<Player *> players;
+    vector<Team> teams;
+    size_t current_team_index = 0;
+    bool started = false;
+    Player *current_player = nullptr;
+    int actions_left = 0;
+    int turn_count = 0;
+    int skip_count = 0;  // turns of teams and players that were skipped
+    bool keep_notices;
+    vector<string> notices;
+    void addDistributions(vector<Move> &moves, enum Extremity::Type mode);
+    string getPlayerKey(Player *player);
+    void saveTurn(Undo &undo);
+    void saveExtremity(Undo &undo, int player_index, enum Extremity::Type mode, int index);
+
+   public:
+    Match(vector<Player *> new_players, bool keep_notices = false);
+    Match(const Match &other);
+    Match &operator=(const Match &other) = delete;
+    ~Match();
+    vector<Player *> &getPlayers() { return players; }
+    vector<Team> &getTeams() { return teams; }
+    size_t getCurrentTeamIndex() { return current_team_index; }
+    Player *getCurrentPlayer() { return current_player; }
+    int getActionsLeft() { return actions_left; }
+    int getTurnCount() { return turn_count; }
+    int getSkipCount() { return skip_count; }
+    vector<string> &getNotices() { return notices; }
+    int getTeamsAliveCount();
+    bool isOver();
+    Team *getWinningTeam();
+    void nextTurn();
+    void endAction();
+    void skipTurn();
+    void forfeit();
+    void getLegalMoves(vector<Move> &moves);
+    vector<Move> getLegalMoves();
+    bool play(Move &move);
+    void makeMove(Move &move, Undo &undo);
+    void unmakeMove(Undo &undo) { restore(undo); }
+    void save(Undo &undo);
+    void restore(Undo &undo);
+    uint64_t hash();
+    string canonicalKey();
+    uint64_t canonicalHash();
+};
+
+/**
+ * takes ownership of new_players, which must be numbered 1 to n in order
+ * and already have their team numbers set to 1 to team count
+ * keep_notices collects a line for every team or player that nextTurn skips
+ */
+Match::Match(vector<Player *> new_players, bool keep_notices) : players(new_players), keep_notices(keep_notices) {
+    int team_count = 0;
+    for (auto &player : players) {
+        if (player->getTeamNumber() > team_count) team_count = player->getTeamNumber();
+    }
+    for (int i = 1; i <= team_count; ++i) {
+        teams.push_back(Team(i));
+    }
+    for (auto &player : players) {
+        teams[player->getTeamNumber() - 1].addPlayer(player);
+    }
+    nextTurn();
+}
+
+/* copies are silent, only the original talks to the clients */
+Match::Match(const Match &other)
+    : current_team_index(other.current_team_index), started(other.started), current_player(nullptr), actions_left(other.actions_left), turn_count(other.turn_count), skip_count(other.skip_count), keep_notices(false) {
+    for (auto &player : other.players) {
+        players.push_back(player->clone());
+        players.back()->setStreams(nullptr, nullptr);
+    }
+    for (auto &team : other.teams) {
+        teams.push_back(Team(team, players));
+    }
+    if (other.current_player != nullptr) {
+        current_player = players[other.current_player->getPlayerNumber() - 1];
+    }
+}
+
+Match::~Match() {
+    for (auto &player : players) {
+        delete player;
+    }
+}
+
+int Match::getTeamsAliveCount() {
+    int result = 0;
+    for (auto &team : teams) {
+        if (team.isAlive()) ++result;
+    }
+    return result;
+}
+
+bool Match::isOver() {
+    return getTeamsAliveCount() <= 1;
+}
+
+/* @return the last alive team else std::nullptr if the game is not yet over */
+Team *Match::getWinningTeam() {
+    if (!isOver()) return nullptr;
+    for (auto &team : teams) {
+        if (team.isAlive()) return &team;
+    }
+    return nullptr;
+}
+
+/**
+ * moves to the next player who can act, skipping teams and players the same way runServer does
+ * leaves no current player if the game is over or if no alive team can ever act again
+ */
+void Match::nextTurn() {
+    current_player = nullptr;
+    actions_left = 0;
+    if (isOver()) return;
+    ++turn_count;
+    // every skip flag is cleared after one skip, so two rounds of skipped teams means a stalled game
+    for (size_t skipped_teams = 0; skipped_teams <= 2 * teams.size();) {
+        if (started) {
+            current_team_index = (current_team_index + 1) % teams.size();
+        } else {
+            started = true;
+        }
+        Team *current_team = &teams[current_team_index];
+        if (!current_team->isAlive()) continue;
+        if (current_team->isSkipping()) {
+            current_team->skip();
+            ++skip_count;
+            if (keep_notices) notices.push_back("Team " + to_string(current_team->getTeamNumber()) + " has been skipped.");
+            ++skipped_teams;
+            continue;
+        }
+        Player *next_player = current_team->getAndSetNextAlivePlayer();
+        while (next_player->isSkipping() || !next_player->canMakeAnAction()) {
+            if (keep_notices) {
+                notices.push_back("Player " + to_string(next_player->getPlayerNumber()) + (next_player->canMakeAnAction() ? "" : " can't make any action and") + " has been skipped.");
+            }
+            next_player->hasBeenSkipped();
+            ++skip_count;
+            next_player = current_team->getAndSetNextAlivePlayer();
+        }
+        current_player = next_player;
+        actions_left = current_player->getTurns();
+        return;
+    }
+}
+
+/* counts one action of the current player, then passes the turn when no action is left */
+void Match::endAction() {
+    --actions_left;
+    if (isOver()) {
+        current_player = nullptr;
+        actions_left = 0;
+    } else if (actions_left <= 0 || !current_player->canMakeAnAction()) {
+        nextTurn();
+    }
+}
+
+/* ends the current player's turn without an action, like any other skipped turn */
+void Match::skipTurn() {
+    if (current_player == nullptr) return;
+    if (keep_notices) notices.push_back("Player " + to_string(current_player->getPlayerNumber()) + " has been skipped.");
+    ++skip_count;
+    nextTurn();
+}
+
+/* the current player gives up and the turn passes */
+void Match::forfeit() {
+    if (current_player == nullptr) return;
+    if (keep_notices) notices.push_back("Player " + to_string(current_player->getPlayerNumber()) + " has forfeited.");
+    current_player->forfeit();
+    if (isOver()) {
+        current_player = nullptr;
+        actions_left = 0;
+    } else {
+        nextTurn();
+    }
+}
+
+/* adds every redistribution of the current player's alive extremities of mode that changes a count */
+void Match::addDistributions(vector<Move> &moves, enum Extremity::Type mode) {
+    if (current_player->getExtremitiesCount(mode, true) <= 1) return;
+    int size = current_player->getExtremitiesCount(mode);
+    int current[MAX_EXTREMITIES] = {}, limits[MAX_EXTREMITIES] = {};
+    int sum = 0;
+    for (int i = 0; i < size; ++i) {
+        Extremity *extremity = current_player->getExtremity(mode, i);
+        if (extremity->isAlive()) {
+            current[i] = extremity->getCount();
+            limits[i] = extremity->getMaxCount();
+            sum += current[i];
+        }
+    }
+    // odometer over alive extremities, the last alive one takes the remainder
+    int last = size - 1;
+    while (limits[last] == 0) --last;
+    Move move;
+    move.type = Move::DISTRIBUTE;
+    move.mode = mode;
+    move.counts_size = size;
+    for (;;) {
+        int partial = 0;
+        for (int i = 0; i < last; ++i) partial += move.counts[i];
+        int remainder = sum - partial;
+        if (0 <= remainder && remainder < limits[last]) {
+            move.counts[last] = remainder;
+            if (!equal(move.counts, move.counts + size, current)) moves.push_back(move);
+        }
+        int i = 0;
+        while (i < last && (limits[i] == 0 || move.counts[i] + 1 >= limits[i])) {
+            move.counts[i] = 0;
+            ++i;
+        }
+        if (i >= last) break;
+        ++move.counts[i];
+    }
+}
+
+/* replaces moves with every action the current player may make, in the order it would be typed */
+void Match::getLegalMoves(vector<Move> &moves) {
+    moves.clear();
+    if (current_player == nullptr) return;
+    enum Extremity::Type modes[] = {Extremity::HAND, Extremity::FOOT};
+    Move move;
+    move.type = Move::TAP;
+    for (auto &mode : modes) {
+        for (int from = 0; from < current_player->getExtremitiesCount(mode); ++from) {
+            Extremity *my_ex = current_player->getExtremity(mode, from);
+            if (!my_ex->isAlive() || my_ex->getCount() == 0) continue;
+            for (auto &target : players) {
+                if (!target->isAlive() || target->getTeamNumber() == current_player->getTeamNumber()) continue;
+                for (auto &target_mode : modes) {
+                    for (int to = 0; to < target->getExtremitiesCount(target_mode); ++to) {
+                        if (!target->getExtremity(target_mode, to)->isAlive()) continue;
+                        move.mode = mode;
+                        move.from = from;
+                        move.target_player = target->getPlayerNumber();
+                        move.target_mode = target_mode;
+                        move.to = to;
+                        moves.push_back(move);
+                    }
+                }
+            }
+        }
+    }
+    addDistributions(moves, Extremity::HAND);
+    addDistributions(moves, Extremity::FOOT);
+}
+
+vector<Move> Match::getLegalMoves() {
+    vector<Move> moves;
+    getLegalMoves(moves);
+    return moves;
+}
+
+/**
+ * applies move with the same checks as Player::playWith
+ * @return true if valid move else false
+ */
+bool Match::play(Move &move) {
+    if (current_player == nullptr) return false;
+    bool valid;
+    if (move.type == Move::TAP) {
+        string from = (move.mode == Extremity::HAND ? "H" : "F") + string(1, (char)('A' + move.from));
+        string to = (move.target_mode == Extremity::HAND ? "H" : "F") + string(1, (char)('A' + move.to));
+        valid = current_player->attack(*players[move.target_player - 1], from, to);
+    } else {
+        valid = current_player->distribute(move.mode, vector<int>(move.counts, move.counts + move.counts_size));
+    }
+    if (!valid) return false;
+    endAction();
+    return true;
+}
+
+void Match::saveTurn(Undo &undo) {
+    undo.extremities_size = 0;
+    undo.alive_players = 0;
+    undo.skipping_players = 0;
+    for (size_t i = 0; i < players.size(); ++i) {
+        undo.hands_sizes[i] = players[i]->getHandsSize();
+        if (players[i]->isAlive()) undo.alive_players |= 1 << i;
+        if (players[i]->isSkipping()) undo.skipping_players |= 1 << i;
+    }
+    for (size_t i = 0; i < teams.size(); ++i) {
+        undo.team_cursors[i] = teams[i].getCurrentPlayer() == nullptr ? -1 : teams[i].getCurrentPlayerIndex();
+    }
+    undo.current_team_index = current_team_index;
+    undo.started = started;
+    undo.current_player_index = current_player == nullptr ? -1 : current_player->getPlayerNumber() - 1;
+    undo.actions_left = actions_left;
+    undo.turn_count = turn_count;
+    undo.skip_count = skip_count;
+}
+
+void Match::saveExtremity(Undo &undo, int player_index, enum Extremity::Type mode, int index) {
+    Extremity *extremity = players[player_index]->getExtremity(mode, index);
+    Undo::ExtremityState &state = undo.extremities[undo.extremities_size++];
+    state.player_index = player_index;
+    state.mode = mode;
+    state.index = index;
+    state.count = extremity->getCount();
+    state.alive = extremity->isAlive();
+}
+
+/**
+ * applies a move from getLegalMoves in place, recording only what it changes
+ * assumes move is legal
+ */
+void Match::makeMove(Move &move, Undo &undo) {
+    saveTurn(undo);
+    int player_index = current_player->getPlayerNumber() - 1;
+    if (move.type == Move::TAP) {
+        Player *target = players[move.target_player - 1];
+        saveExtremity(undo, move.target_player - 1, move.target_mode, move.to);
+        current_player->attack(*target, current_player->getExtremity(move.mode, move.from), target->getExtremity(move.target_mode, move.to));
+    } else {
+        for (int i = 0; i < move.counts_size; ++i) {
+            saveExtremity(undo, player_index, move.mode, i);
+            current_player->getExtremity(move.mode, i)->setCount(move.counts[i]);
+        }
+    }
+    endAction();
+}
+
+/* records the whole position, for changes made outside of makeMove */
+void Match::save(Undo &undo) {
+    saveTurn(undo);
+    enum Extremity::Type modes[] = {Extremity::HAND, Extremity::FOOT};
+    for (size_t i = 0; i < players.size(); ++i) {
+        for (auto &mode : modes) {
+            for (int j = 0; j < players[i]->getExtremitiesCount(mode); ++j) {
+                saveExtremity(undo, i, mode, j);
+            }
+        }
+    }
+}
+
+/* puts back the position recorded by makeMove or save, undos must be restored newest first */
+void Match::restore(Undo &undo) {
+    for (size_t i = 0; i < players.size(); ++i) {
+        while (players[i]->getHandsSize() > undo.hands_sizes[i]) players[i]->undoRegrow();
+        players[i]->restoreState(undo.alive_players & (1 << i), undo.skipping_players & (1 << i));
+    }
+    for (int i = 0; i < undo.extremities_size; ++i) {
+        Undo::ExtremityState &state = undo.extremities[i];
+        players[state.player_index]->getExtremity((enum Extremity::Type)state.mode, state.index)->restore(state.count, state.alive);
+    }
+    for (size_t i = 0; i < teams.size(); ++i) {
+        teams[i].restoreCursor(undo.team_cursors[i]);
+    }
+    current_team_index = undo.current_team_index;
+    started = undo.started;
+    current_player = undo.current_player_index < 0 ? nullptr : players[undo.current_player_index];
+    actions_left = undo.actions_left;
+    turn_count = undo.turn_count;
+    skip_count = undo.skip_count;
+}
+
+/* 64-bit hash of everything that affects the rest of the game */
+uint64_t Match::hash() {
+    uint64_t result = 0xcbf29ce484222325ULL;
+    auto mix = [&result](uint64_t value) {
+        result ^= value + 0x9e3779b97f4a7c15ULL + (result << 6) + (result >> 2);
+        result *= 0x100000001b3ULL;
+    };
+    for (auto &player : players) {
+        mix(player->getHandsSize());
+        for (size_t i = 0; i < player->getHandsSize(); ++i) {
+            Extremity *hand = player->getExtremity(Extremity::HAND, i);
+            mix(hand->isAlive() ? hand->getCount() + 1 : 0);
+        }
+        for (size_t i = 0; i < player->getFeetSize(); ++i) {
+            Extremity *foot = player->getExtremity(Extremity::FOOT, i);
+            mix(foot->isAlive() ? foot->getCount() + 1 : 0);
+        }
+        mix(player->isSkipping());
+    }
+    for (auto &team : teams) {
+        mix(team.getCurrentPlayer() == nullptr ? 0 : team.getCurrentPlayerIndex() + 1);
+    }
+    mix(started ? current_team_index + 1 : 0);
+    mix(current_player == nullptr ? 0 : current_player->getPlayerNumber());
+    mix(actions_left);
+    return result;
+}
+
+/* extremities of one type are interchangeable, so their states are sorted */
+string Match::getPlayerKey(Player *player) {
+    string result;
+    result += (char)player->getType();
+    result += (char)player->getHandsSize();  // a zombie regrows only while it has its starting hand
+    enum Extremity::Type modes[] = {Extremity::HAND, Extremity::FOOT};
+    for (auto &mode : modes) {
+        string states;
+        for (int i = 0; i < player->getExtremitiesCount(mode); ++i) {
+            Extremity *extremity = player->getExtremity(mode, i);
+            states += (char)(extremity->isAlive() ? extremity->getCount() + 1 : 0);
+        }
+        sort(states.begin(), states.end());
+        result += states;
+    }
+    result += (char)player->isSkipping();
+    return result;
+}
+
+/**
+ * encoding shared by all positions that only differ by the order of a player's hands or feet,
+ * or by a rotation of a team's turn order that maps every player onto one of the same class
+ */
+string Match::canonicalKey() {
+    string result;
+    for (auto &team : teams) {
+        vector<Player *> &team_players = team.getPlayers();
+        size_t size = team_players.size();
+        vector<string> keys;
+        for (auto &player : team_players) {
+            keys.push_back(getPlayerKey(player));
+        }
+        // before its first turn a team always starts with its first player, so it can't be rotated
+        bool has_cursor = team.getCurrentPlayer() != nullptr;
+        string best;
+        for (size_t rotation = 0; rotation < (has_cursor ? size : 1); ++rotation) {
+            bool same_classes = true;
+            for (size_t i = 0; i < size && same_classes; ++i) {
+                same_classes = team_players[i]->getType() == team_players[(i + rotation) % size]->getType();
+            }
+            if (!same_classes) continue;
+            string candidate;
+            candidate += (char)(has_cursor ? (team.getCurrentPlayerIndex() + size - rotation) % size + 1 : 0);
+            for (size_t i = 0; i < size; ++i) {
+                candidate += keys[(i + rotation) % size];
+            }
+            if (best.empty() || candidate < best) best = candidate;
+        }
+        result += best;
+    }
+    // the current player is always the cursor of the current team
+    result += (char)(started ? current_team_index + 1 : 0);
+    result += (char)(current_player == nullptr ? 0 : 1);
+    result += (char)actions_left;
+    return result;
+}
+
+uint64_t Match::canonicalHash() {
+    uint64_t result = 0xcbf29ce484222325ULL;
+    for (auto &byte : canonicalKey()) {
+        result ^= (unsigned char)byte;
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+}
+
+#endif /* MATCH_HPP */
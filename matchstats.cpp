@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "history.hpp"
+
+using namespace std;
+
+/**
+ * aggregates over a match history written by the server with -r
+ * usage: matchstats <file> [summary|classes|teams|turns|openings|skips|all] [-p players] [-n rows]
+ * example: matchstats matches.history teams -p 4 -n 20
+ * only the columns the query needs are decoded, and each query is a loop over those columns
+ * build: g++ -std=c++11 -O2 matchstats.cpp -o matchstats
+ */
+
+const char *CLASS_NAMES[] = {"human", "alien", "zombie", "doggo"};
+const int CLASS_COUNT = 4;
+const char *ENDING_NAMES[] = {"finished", "disconnected", "timed out", "fell behind"};
+const int ENDING_COUNT = 4;
+
+/* a team's classes as 3 bit counts per class, so team compositions index a flat table */
+const int COMPOSITION_COUNT = 1 << (3 * CLASS_COUNT);
+
+string getCompositionName(int composition) {
+    string result;
+    for (int type = 0; type < CLASS_COUNT; ++type) {
+        for (int i = 0; i < ((composition >> (3 * type)) & 7); ++i) {
+            result += (result.empty() ? "" : "+") + string(CLASS_NAMES[type]);
+        }
+    }
+    return result;
+}
+
+/* bit per query, each one decodes and aggregates only the columns it needs */
+enum Query { SUMMARY = 1,
+             CLASSES = 2,
+             TEAMS = 4,
+             TURNS = 8,
+             OPENINGS = 16,
+             SKIPS = 32,
+             ALL = 63 };
+
+uint32_t getColumns(int queries, bool filtered) {
+    uint32_t result = 0;
+    auto need = [&result](HistoryBlock::Column column) { result |= 1 << column; };
+    if (filtered || (queries & (CLASSES | TEAMS | TURNS | SKIPS))) need(HistoryBlock::PLAYER_COUNT);
+    if (queries & (SUMMARY | CLASSES | TEAMS | OPENINGS)) {
+        need(HistoryBlock::ENDING);
+        need(HistoryBlock::WINNING_TEAM);
+    }
+    if (queries & SUMMARY) need(HistoryBlock::DURATION);
+    if (queries & (CLASSES | TEAMS)) need(HistoryBlock::LINEUP);
+    if (queries & (TURNS | SKIPS)) need(HistoryBlock::TURNS);
+    if (queries & SKIPS) need(HistoryBlock::SKIPS);
+    if (queries & OPENINGS) need(HistoryBlock::OPENING);
+    return result;
+}
+
+struct Stats {
+    uint64_t matches = 0;
+    uint64_t endings[ENDING_COUNT] = {};
+    uint64_t draws = 0;
+    uint64_t seconds = 0;
+    uint64_t by_players[MAX_PLAYERS + 1] = {};
+    uint64_t turns_by_players[MAX_PLAYERS + 1] = {};
+    uint64_t skips_by_players[MAX_PLAYERS + 1] = {};
+    uint64_t skipped_matches_by_players[MAX_PLAYERS + 1] = {};
+    uint64_t class_games[CLASS_COUNT] = {};
+    uint64_t class_wins[CLASS_COUNT] = {};
+    vector<uint64_t> composition_games = vector<uint64_t>(COMPOSITION_COUNT, 0);
+    vector<uint64_t> composition_wins = vector<uint64_t>(COMPOSITION_COUNT, 0);
+    unordered_map<uint64_t, uint64_t> opening_games;
+    unordered_map<uint64_t, uint64_t> opening_first_team_wins;
+    void add(HistoryBlock &block, vector<uint8_t> &selected, int queries);
+    void addLineups(HistoryBlock &block, vector<uint8_t> &selected);
+};
+
+/* selected marks the rows of block that passed the filters, only the columns of queries were decoded */
+void Stats::add(HistoryBlock &block, vector<uint8_t> &selected, int queries) {
+    const vector<uint64_t> &player_counts = block.columns[HistoryBlock::PLAYER_COUNT];
+    const vector<uint64_t> &winners = block.columns[HistoryBlock::WINNING_TEAM];
+    const vector<uint64_t> &endings_column = block.columns[HistoryBlock::ENDING];
+    for (size_t row = 0; row < block.rows; ++row) {
+        matches += selected[row];
+    }
+    if (!endings_column.empty()) {
+        for (size_t row = 0; row < block.rows; ++row) {
+            if (!selected[row]) continue;
+            ++endings[min<uint64_t>(endings_column[row], ENDING_COUNT - 1)];
+            draws += endings_column[row] == MatchSummary::FINISHED && winners[row] == 0;
+        }
+    }
+    if (!player_counts.empty()) {
+        for (size_t row = 0; row < block.rows; ++row) {
+            if (selected[row]) ++by_players[min<uint64_t>(player_counts[row], MAX_PLAYERS)];
+        }
+    }
+    if (queries & SUMMARY) {
+        const vector<uint64_t> &durations = block.columns[HistoryBlock::DURATION];
+        for (size_t row = 0; row < block.rows; ++row) {
+            if (selected[row]) seconds += durations[row];
+        }
+    }
+    if (queries & (TURNS | SKIPS)) {
+        const vector<uint64_t> &turns = block.columns[HistoryBlock::TURNS];
+        for (size_t row = 0; row < block.rows; ++row) {
+            if (selected[row]) turns_by_players[min<uint64_t>(player_counts[row], MAX_PLAYERS)] += turns[row];
+        }
+    }
+    if (queries & SKIPS) {
+        const vector<uint64_t> &skips = block.columns[HistoryBlock::SKIPS];
+        for (size_t row = 0; row < block.rows; ++row) {
+            if (!selected[row]) continue;
+            uint64_t players = min<uint64_t>(player_counts[row], MAX_PLAYERS);
+            skips_by_players[players] += skips[row];
+            skipped_matches_by_players[players] += skips[row] != 0;
+        }
+    }
+    if (queries & (CLASSES | TEAMS)) addLineups(block, selected);
+    if (queries & OPENINGS) {
+        const vector<uint64_t> &openings = block.columns[HistoryBlock::OPENING];
+        for (size_t row = 0; row < block.rows; ++row) {
+            if (!selected[row] || endings_column[row] != MatchSummary::FINISHED || openings[row] == MatchSummary::NO_OPENING) continue;
+            ++opening_games[openings[row]];
+            opening_first_team_wins[openings[row]] += winners[row] == 1;
+        }
+    }
+}
+
+/* classes and compositions only count matches that were played out */
+void Stats::addLineups(HistoryBlock &block, vector<uint8_t> &selected) {
+    const vector<uint64_t> &player_counts = block.columns[HistoryBlock::PLAYER_COUNT];
+    const vector<uint64_t> &lineups = block.columns[HistoryBlock::LINEUP];
+    const vector<uint64_t> &winners = block.columns[HistoryBlock::WINNING_TEAM];
+    const vector<uint64_t> &endings_column = block.columns[HistoryBlock::ENDING];
+    for (size_t row = 0; row < block.rows; ++row) {
+        if (!selected[row] || endings_column[row] != MatchSummary::FINISHED) continue;
+        uint64_t players = min<uint64_t>(player_counts[row], MAX_PLAYERS);
+        int compositions[MAX_PLAYERS + 1] = {};
+        for (uint64_t i = 0; i < players; ++i) {
+            int type = MatchSummary::getClass(lineups[row], i);
+            int group = MatchSummary::getGroup(lineups[row], i);
+            ++class_games[type];
+            class_wins[type] += (uint64_t)group == winners[row];
+            compositions[group] += 1 << (3 * type);
+        }
+        for (int group = 1; group <= MAX_PLAYERS; ++group) {
+            if (compositions[group] == 0) continue;
+            ++composition_games[compositions[group]];
+            composition_wins[compositions[group]] += (uint64_t)group == winners[row];
+        }
+    }
+}
+
+string percent(uint64_t part, uint64_t whole) {
+    ostringstream result;
+    result << fixed << setprecision(1) << (whole == 0 ? 0.0 : 100.0 * part / whole) << "%";
+    return result.str();
+}
+
+string average(uint64_t total, uint64_t count) {
+    ostringstream result;
+    result << fixed << setprecision(2) << (count == 0 ? 0.0 : (double)total / count);
+    return result.str();
+}
+
+/* rows of a table sorted by games, most first */
+void printTop(vector<pair<uint64_t, string>> rows, size_t row_limit) {
+    sort(rows.begin(), rows.end(), [](const pair<uint64_t, string> &a, const pair<uint64_t, string> &b) { return a.first > b.first; });
+    for (size_t i = 0; i < rows.size() && i < row_limit; ++i) {
+        cout << rows[i].second << endl;
+    }
+}
+
+void printSummary(Stats &stats) {
+    cout << "Matches: " << stats.matches << endl;
+    for (int i = 0; i < ENDING_COUNT; ++i) {
+        cout << "  " << ENDING_NAMES[i] << ": " << stats.endings[i] << " (" << percent(stats.endings[i], stats.matches) << ")" << endl;
+    }
+    cout << "  draws: " << stats.draws << " (" << percent(stats.draws, stats.endings[MatchSummary::FINISHED]) << " of finished)" << endl;
+    cout << "Average length: " << average(stats.seconds, stats.matches) << "s" << endl;
+}
+
+void printClasses(Stats &stats) {
+    cout << "Win rate by class, finished matches:" << endl;
+    for (int type = 0; type < CLASS_COUNT; ++type) {
+        cout << "  " << CLASS_NAMES[type] << ": " << percent(stats.class_wins[type], stats.class_games[type]) << " of " << stats.class_games[type] << endl;
+    }
+}
+
+void printTeams(Stats &stats, size_t row_limit) {
+    cout << "Win rate by team composition, finished matches:" << endl;
+    vector<pair<uint64_t, string>> rows;
+    for (int composition = 1; composition < COMPOSITION_COUNT; ++composition) {
+        uint64_t games = stats.composition_games[composition];
+        if (games == 0) continue;
+        rows.push_back(make_pair(games, "  " + getCompositionName(composition) + ": " + percent(stats.composition_wins[composition], games) + " of " + to_string(games)));
+    }
+    printTop(rows, row_limit);
+}
+
+void printTurns(Stats &stats) {
+    cout << "Average turns by player count:" << endl;
+    uint64_t total = 0;
+    for (int players = 2; players <= MAX_PLAYERS; ++players) {
+        total += stats.turns_by_players[players];
+        if (stats.by_players[players] == 0) continue;
+        cout << "  " << players << " players: " << average(stats.turns_by_players[players], stats.by_players[players]) << " over " << stats.by_players[players] << " matches" << endl;
+    }
+    cout << "  all: " << average(total, stats.matches) << endl;
+}
+
+void printOpenings(Stats &stats, size_t row_limit) {
+    cout << "Most common opening actions:" << endl;
+    vector<pair<uint64_t, string>> rows;
+    for (auto &opening : stats.opening_games) {
+        uint64_t games = opening.second;
+        string line = "  " + MatchSummary::unpackMove(opening.first).toString() + ": " + to_string(games) + " (" + percent(games, stats.endings[MatchSummary::FINISHED]) + "), team 1 wins " + percent(stats.opening_first_team_wins[opening.first], games);
+        rows.push_back(make_pair(games, line));
+    }
+    printTop(rows, row_limit);
+}
+
+void printSkips(Stats &stats) {
+    cout << "Skipped turns by player count:" << endl;
+    uint64_t skips = 0, skipped_matches = 0, turns = 0;
+    for (int players = 2; players <= MAX_PLAYERS; ++players) {
+        skips += stats.skips_by_players[players];
+        skipped_matches += stats.skipped_matches_by_players[players];
+        turns += stats.turns_by_players[players];
+        if (stats.by_players[players] == 0) continue;
+        cout << "  " << players << " players: " << average(stats.skips_by_players[players], stats.by_players[players]) << " per match, "
+             << percent(stats.skips_by_players[players], stats.turns_by_players[players]) << " of turns, in "
+             << percent(stats.skipped_matches_by_players[players], stats.by_players[players]) << " of matches" << endl;
+    }
+    cout << "  all: " << average(skips, stats.matches) << " per match, " << percent(skips, turns) << " of turns, in " << percent(skipped_matches, stats.matches) << " of matches" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: matchstats <file> [summary|classes|teams|turns|openings|skips|all] [-p players] [-n rows]" << endl;
+        return 1;
+    }
+    string query = "all";
+    int player_filter = 0;
+    int row_limit = 10;
+    for (int i = 2; i < argc; ++i) {
+        string argument = argv[i];
+        if ((argument == "-p" || argument == "-n") && i + 1 < argc && isValidInt(argv[i + 1])) {
+            (argument == "-p" ? player_filter : row_limit) = stoi(argv[++i]);
+        } else {
+            query = argument;
+        }
+    }
+    vector<string> queries = {"summary", "classes", "teams", "turns", "openings", "skips", "all"};
+    size_t query_index = find(queries.begin(), queries.end(), query) - queries.begin();
+    if (query_index == queries.size()) {
+        cerr << "Query must be summary, classes, teams, turns, openings, skips or all." << endl;
+        return 1;
+    }
+    int query_bits = query == "all" ? ALL : 1 << query_index;
+    uint32_t columns = getColumns(query_bits, player_filter != 0);
+    HistoryReader reader(argv[1]);
+    if (!reader.isOpen()) {
+        cerr << "Could not open " << argv[1] << "." << endl;
+        return 1;
+    }
+    auto start = chrono::steady_clock::now();
+
+    Stats stats;
+    HistoryBlock block;
+    vector<uint8_t> selected;
+    while (reader.nextBlock(block, columns)) {
+        const vector<uint64_t> &player_counts = block.columns[HistoryBlock::PLAYER_COUNT];
+        selected.resize(block.rows);
+        for (size_t row = 0; row < block.rows; ++row) {
+            selected[row] = player_filter == 0 || player_counts[row] == (uint64_t)player_filter;
+        }
+        stats.add(block, selected, query_bits);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (query == "summary" || query == "all") printSummary(stats);
+    if (query == "classes" || query == "all") printClasses(stats);
+    if (query == "teams" || query == "all") printTeams(stats, row_limit);
+    if (query == "turns" || query == "all") printTurns(stats);
+    if (query == "openings" || query == "all") printOpenings(stats, row_limit);
+    if (query == "skips" || query == "all") printSkips(stats);
+    cout << "Scanned " << stats.matches << " matches in " << seconds << "s" << endl;
+    return 0;
+}
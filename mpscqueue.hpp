@@ -0,0 +1,132 @@
+#pragma once
+#ifndef MPSCQUEUE_HPP
+#define MPSCQUEUE_HPP
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * bounded lock-free queue, any number of threads push and one thread pops
+ * every cell carries a sequence number telling whose turn it is, so producers only contend on the tail
+ * the consumer sleeps on an eventfd, producers only write to it when the consumer said it is going to sleep
+ */
+template <typename T>
+class MpscQueue {
+   private:
+    struct Cell {
+        atomic<size_t> sequence;  // position when free, position + 1 once filled
+        T value;
+    };
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    int wake_fd;
+    alignas(64) atomic<size_t> tail;  // next position to push, shared by producers
+    alignas(64) atomic<bool> sleeping;
+    alignas(64) size_t head = 0;  // next position to pop, consumer only
+    bool isHeadFilled() { return cells[head & mask].sequence.load(memory_order_acquire) == head + 1; }
+
+   public:
+    MpscQueue(size_t capacity);
+    MpscQueue(const MpscQueue &other) = delete;
+    ~MpscQueue() { ::close(wake_fd); }
+    int getWakeFd() { return wake_fd; }
+    bool tryPush(T value);
+    size_t popBatch(vector<T> &values, size_t max_count);
+    bool prepareSleep();
+    void finishSleep();
+};
+
+/* capacity is rounded up to a power of two */
+template <typename T>
+MpscQueue<T>::MpscQueue(size_t capacity) : wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), tail(0), sleeping(false) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    cells.reset(new Cell[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+        cells[i].sequence.store(i, memory_order_relaxed);
+    }
+}
+
+/* @return false if the queue is full, safe to call from any thread */
+template <typename T>
+bool MpscQueue<T>::tryPush(T value) {
+    size_t position = tail.load(memory_order_relaxed);
+    for (;;) {
+        Cell &cell = cells[position & mask];
+        size_t sequence = cell.sequence.load(memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                cell.value = move(value);
+                cell.sequence.store(position + 1, memory_order_release);
+                break;
+            }
+        } else if (difference < 0) {
+            return false;  // the consumer has not freed this cell since the last lap
+        } else {
+            position = tail.load(memory_order_relaxed);  // another producer took it
+        }
+    }
+    // pairs with the fence in prepareSleep, either the consumer sees the value or we see it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sleeping.load(memory_order_relaxed) && sleeping.exchange(false)) {
+        uint64_t one = 1;
+        if (::write(wake_fd, &one, sizeof one) < 0) {
+            // counter is already nonzero, the consumer wakes anyway
+        }
+    }
+    return true;
+}
+
+/**
+ * moves up to max_count values in push order to the end of values, consumer only
+ * stops early at a cell a producer has claimed but not filled yet, that producer wakes the consumer once done
+ * @return the number of values moved
+ */
+template <typename T>
+size_t MpscQueue<T>::popBatch(vector<T> &values, size_t max_count) {
+    size_t count = 0;
+    while (count < max_count && isHeadFilled()) {
+        Cell &cell = cells[head & mask];
+        values.push_back(move(cell.value));
+        cell.value = T();
+        cell.sequence.store(head + mask + 1, memory_order_release);
+        ++head;
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * call before blocking on getWakeFd, consumer only
+ * @return false if there is already something to pop and the consumer should not block
+ */
+template <typename T>
+bool MpscQueue<T>::prepareSleep() {
+    sleeping.store(true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!isHeadFilled()) return true;
+    sleeping.store(false, memory_order_relaxed);
+    return false;
+}
+
+/* call after blocking following a successful prepareSleep, consumer only */
+template <typename T>
+void MpscQueue<T>::finishSleep() {
+    sleeping.store(false, memory_order_relaxed);
+    uint64_t count;
+    if (::read(wake_fd, &count, sizeof count) < 0) {
+        // not signalled, the consumer woke for something else
+    }
+}
+
+#endif /* MPSCQUEUE_HPP */
@@ -0,0 +1,103 @@
+#pragma once
+#ifndef OPENINGBOOK_HPP
+#define OPENINGBOOK_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "match.hpp"
+#include "search.hpp"
+
+using namespace std;
+
+/* one searched position, keyed like the position cache so the move index is in getLegalMoves order */
+struct BookEntry {
+    uint64_t key;
+    int32_t score;
+    uint16_t depth;
+    uint16_t move_index;
+};
+
+/**
+ * read-only table of positions searched offline, sorted by key and found by binary search
+ * the file is an 8 byte magic, the entry count, then the entries, and is mapped rather than read
+ */
+class OpeningBook {
+   private:
+    static const int HEADER_SIZE = 16;
+    void *mapped = nullptr;
+    size_t mapped_size = 0;
+    const BookEntry *entries = nullptr;
+    uint64_t count = 0;
+
+   public:
+    OpeningBook(string path);
+    OpeningBook(const OpeningBook &other) = delete;
+    ~OpeningBook();
+    bool isOpen() { return mapped != nullptr; }
+    uint64_t size() { return count; }
+    bool find(Match &match, int team_number, SearchResult &result);
+    static bool write(string path, vector<BookEntry> &entries);
+};
+
+/* isOpen is false if path is missing or is not a book */
+OpeningBook::OpeningBook(string path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size >= HEADER_SIZE) {
+        mapped_size = status.st_size;
+        mapped = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) mapped = nullptr;
+    }
+    close(fd);
+    if (mapped == nullptr) return;
+    memcpy(&count, (char *)mapped + 8, sizeof count);
+    if (memcmp(mapped, "CHOPBOOK", 8) != 0 || HEADER_SIZE + count * sizeof(BookEntry) != mapped_size) {
+        munmap(mapped, mapped_size);
+        mapped = nullptr;
+        count = 0;
+        return;
+    }
+    entries = (const BookEntry *)((char *)mapped + HEADER_SIZE);
+}
+
+OpeningBook::~OpeningBook() {
+    if (mapped != nullptr) munmap(mapped, mapped_size);
+}
+
+/* @return false if the position is not in the book, otherwise result is what the offline search found */
+bool OpeningBook::find(Match &match, int team_number, SearchResult &result) {
+    if (count == 0 || match.getCurrentPlayer() == nullptr) return false;
+    uint64_t key = match.hash() ^ Search::getLineupKey(match, team_number);
+    const BookEntry *found = lower_bound(entries, entries + count, key, [](const BookEntry &entry, uint64_t key) { return entry.key < key; });
+    if (found == entries + count || found->key != key) return false;
+    vector<Move> moves = match.getLegalMoves();
+    if (found->move_index >= moves.size()) return false;
+    result.has_move = true;
+    result.best_move = moves[found->move_index];
+    result.score = found->score;
+    result.depth = found->depth;
+    return true;
+}
+
+/* sorts entries, keeping the deepest of any duplicates, @return false if path could not be written */
+bool OpeningBook::write(string path, vector<BookEntry> &entries) {
+    sort(entries.begin(), entries.end(), [](const BookEntry &a, const BookEntry &b) { return a.key != b.key ? a.key < b.key : a.depth > b.depth; });
+    entries.erase(unique(entries.begin(), entries.end(), [](const BookEntry &a, const BookEntry &b) { return a.key == b.key; }), entries.end());
+    ofstream file(path, ios::binary | ios::trunc);
+    uint64_t count = entries.size();
+    file.write("CHOPBOOK", 8);
+    file.write((const char *)&count, sizeof count);
+    file.write((const char *)entries.data(), count * sizeof(BookEntry));
+    return (bool)file;
+}
+
+#endif /* OPENINGBOOK_HPP */
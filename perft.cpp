@@ -0,0 +1,179 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "match.hpp"
+
+using namespace std;
+
+/**
+ * counts the positions reachable in exactly depth actions of the rules engine
+ * usage: perft <depth> <class>:<group> <class>:<group> ... [-j threads] [-t table megabytes]
+ * example: perft 6 human:1 zombie:2 doggo:2 -j 8 -t 64
+ * build: g++ -std=c++11 -O2 -pthread perft.cpp -o perft
+ */
+
+struct TableEntry {
+    atomic<uint64_t> check;  // key ^ nodes, so torn writes never match
+    atomic<uint64_t> nodes;
+};
+
+/* lockless transposition table of subtree sizes, shared by all threads and keyed by canonical position */
+class PerftTable {
+   private:
+    TableEntry *entries = nullptr;
+    size_t size = 0;
+    uint64_t keyOf(uint64_t hash, int depth) { return hash ^ ((uint64_t)depth * 0x9e3779b97f4a7c15ULL); }
+
+   public:
+    PerftTable(size_t megabytes);
+    ~PerftTable() { delete[] entries; }
+    bool isEnabled() { return size != 0; }
+    bool probe(uint64_t hash, int depth, uint64_t &nodes);
+    void store(uint64_t hash, int depth, uint64_t nodes);
+};
+
+PerftTable::PerftTable(size_t megabytes) {
+    size = megabytes * 1024 * 1024 / sizeof(TableEntry);
+    if (size == 0) return;
+    entries = new TableEntry[size];
+    for (size_t i = 0; i < size; ++i) {
+        entries[i].check.store(0, memory_order_relaxed);
+        entries[i].nodes.store(0, memory_order_relaxed);
+    }
+}
+
+bool PerftTable::probe(uint64_t hash, int depth, uint64_t &nodes) {
+    uint64_t key = keyOf(hash, depth);
+    TableEntry &entry = entries[key % size];
+    uint64_t found_nodes = entry.nodes.load(memory_order_relaxed);
+    if ((entry.check.load(memory_order_relaxed) ^ found_nodes) != key) return false;
+    nodes = found_nodes;
+    return true;
+}
+
+void PerftTable::store(uint64_t hash, int depth, uint64_t nodes) {
+    uint64_t key = keyOf(hash, depth);
+    TableEntry &entry = entries[key % size];
+    entry.check.store(key ^ nodes, memory_order_relaxed);
+    entry.nodes.store(nodes, memory_order_relaxed);
+}
+
+/**
+ * games that ended before depth contribute no nodes, like perft in chess
+ * move_lists holds one reused list per remaining depth, so the walk itself never allocates
+ */
+uint64_t perft(Match &match, int depth, PerftTable &table, vector<vector<Move>> &move_lists) {
+    if (depth == 0) return 1;
+    vector<Move> &moves = move_lists[depth];
+    match.getLegalMoves(moves);
+    if (depth == 1) return moves.size();
+    uint64_t nodes = 0;
+    uint64_t hash = 0;
+    if (table.isEnabled()) {
+        hash = match.canonicalHash();
+        if (table.probe(hash, depth, nodes)) return nodes;
+    }
+    Undo undo;
+    for (auto &move : moves) {
+        match.makeMove(move, undo);
+        nodes += perft(match, depth - 1, table, move_lists);
+        match.unmakeMove(undo);
+    }
+    if (table.isEnabled()) table.store(hash, depth, nodes);
+    return nodes;
+}
+
+struct PerftTask {
+    size_t root_index;
+    Match *match;
+    int depth;
+    uint64_t nodes;
+};
+
+/* @return false if arguments are invalid */
+bool parseArguments(int argc, char *argv[], vector<Player *> &players, int &threads, int &table_megabytes) {
+    vector<string> lineup;
+    for (int i = 2; i < argc; ++i) {
+        string argument = argv[i];
+        if ((argument == "-j" || argument == "-t") && i + 1 < argc) {
+            if (!isValidInt(argv[i + 1]) || stoi(argv[i + 1]) < 0) return false;
+            (argument == "-j" ? threads : table_megabytes) = stoi(argv[++i]);
+        } else {
+            lineup.push_back(argument);
+        }
+    }
+    return createLineup(lineup, players);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4 || !isValidInt(argv[1]) || stoi(argv[1]) < 1) {
+        cerr << "Usage: perft <depth> <class>:<group> <class>:<group> ... [-j threads] [-t table megabytes]" << endl;
+        return 1;
+    }
+    int depth = stoi(argv[1]);
+    int threads = thread::hardware_concurrency();
+    int table_megabytes = 0;
+    vector<Player *> players;
+    if (!parseArguments(argc, argv, players, threads, table_megabytes)) {
+        cerr << "Invalid players or groups. There must be 2 to 6 players in groups 1 to n." << endl;
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+    Match root(players);
+    PerftTable table(table_megabytes);
+    auto start = chrono::steady_clock::now();
+
+    // split the first one or two plies into tasks so that every thread has work to take
+    vector<Move> root_moves = root.getLegalMoves();
+    int split = (depth >= 3 && root_moves.size() < (size_t)threads * 4) ? 2 : 1;
+    vector<PerftTask> tasks;
+    for (size_t i = 0; i < root_moves.size(); ++i) {
+        Match *child = new Match(root);
+        child->play(root_moves[i]);
+        if (split == 1) {
+            tasks.push_back({i, child, depth - 1, 0});
+            continue;
+        }
+        for (auto &move : child->getLegalMoves()) {
+            Match *grandchild = new Match(*child);
+            grandchild->play(move);
+            tasks.push_back({i, grandchild, depth - 2, 0});
+        }
+        delete child;
+    }
+    atomic<size_t> next_task(0);
+    vector<thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.push_back(thread([&]() {
+            vector<vector<Move>> move_lists(depth + 1);
+            for (size_t task = next_task++; task < tasks.size(); task = next_task++) {
+                tasks[task].nodes = perft(*tasks[task].match, tasks[task].depth, table, move_lists);
+            }
+        }));
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    vector<uint64_t> root_nodes(root_moves.size(), 0);
+    uint64_t total = 0;
+    for (auto &task : tasks) {
+        root_nodes[task.root_index] += task.nodes;
+        total += task.nodes;
+        delete task.match;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < root_moves.size(); ++i) {
+        cout << root_moves[i].toString() << ": " << root_nodes[i] << endl;
+    }
+    cout << endl;
+    cout << "Depth: " << depth << endl;
+    cout << "Nodes: " << total << endl;
+    cout << "Time: " << seconds << "s" << endl;
+    cout << "Nodes/second: " << (uint64_t)(seconds > 0 ? total / seconds : 0) << endl;
+    return 0;
+}
@@ -0,0 +1,174 @@
+#pragma once
+#ifndef POSITIONCACHE_HPP
+#define POSITIONCACHE_HPP
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+/* what a search found below one position, scores are from the searching team's view */
+struct CachedPosition {
+    static const int NO_MOVE = 1023;
+    enum Bound { NONE,
+                 EXACT,
+                 LOWER,    // the score is at least this
+                 UPPER };  // the score is at most this
+    int score = 0;
+    int depth = 0;            // plies searched below the position
+    Bound bound = NONE;
+    int move_index = NO_MOVE;  // best move's index in getLegalMoves order
+};
+
+/**
+ * transposition cache in a memory mapped file, shared by every search thread and every server process using the file
+ * entries are written without locks, key ^ data is stored next to data so torn or racing writes never match
+ * a bucket is one cache line of entries, the one replaced was least recently used by a search and then the shallowest
+ */
+class PositionCache {
+   public:
+    static const int BUCKET_SIZE = 4;
+
+   private:
+    struct Entry {
+        atomic<uint64_t> check;
+        atomic<uint64_t> data;  // score, depth, bound, move index, age from low to high bits
+    };
+    struct Header {
+        char magic[8];
+        uint64_t bucket_count;
+    };
+    static const int HEADER_SIZE = 64;
+    static const uint32_t AGE_MASK = 0xfff;
+    void *mapped = nullptr;
+    atomic<uint32_t> *generation = nullptr;  // right after the header, bumped by every search
+    Entry *entries = nullptr;
+    uint64_t bucket_count = 0;
+    size_t mapped_size = 0;
+    uint64_t pack(const CachedPosition &position, uint32_t age);
+    CachedPosition unpack(uint64_t data);
+    uint32_t getAge(uint64_t data) { return (uint32_t)(data >> 52) & AGE_MASK; }
+
+   public:
+    PositionCache(string path, uint64_t megabytes);
+    PositionCache(const PositionCache &other) = delete;
+    ~PositionCache();
+    bool isOpen() { return entries != nullptr; }
+    uint32_t newSearch() { return (generation->fetch_add(1, memory_order_relaxed) + 1) & AGE_MASK; }
+    bool probe(uint64_t key, CachedPosition &position, uint32_t age);
+    void store(uint64_t key, const CachedPosition &position, uint32_t age);
+};
+
+static_assert(sizeof(atomic<uint64_t>) == sizeof(uint64_t) && ATOMIC_LLONG_LOCK_FREE == 2, "entries must be plain lock-free words to be shared between processes");
+
+/**
+ * maps path, creating it or starting over if it was not written by a cache of this size
+ * isOpen is false if the file could not be used, searches then run without a cache
+ */
+PositionCache::PositionCache(string path, uint64_t megabytes) {
+    uint64_t wanted_buckets = megabytes * 1024 * 1024 / (BUCKET_SIZE * sizeof(Entry));
+    if (wanted_buckets == 0) return;
+    size_t size = HEADER_SIZE + wanted_buckets * BUCKET_SIZE * sizeof(Entry);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    // only setting up the file takes a lock, so processes starting together agree on its contents
+    flock(fd, LOCK_EX);
+    struct stat status;
+    bool valid = fstat(fd, &status) == 0 && (size_t)status.st_size == size;
+    Header existing;
+    if (valid) {
+        valid = pread(fd, &existing, sizeof existing, 0) == (ssize_t)sizeof existing &&
+                memcmp(existing.magic, "CHOPPOS1", 8) == 0 && existing.bucket_count == wanted_buckets;
+    }
+    if (!valid) {
+        // a truncated file reads back as zeros, which no key matches
+        Header fresh;
+        memcpy(fresh.magic, "CHOPPOS1", 8);
+        fresh.bucket_count = wanted_buckets;
+        valid = ftruncate(fd, 0) == 0 && ftruncate(fd, size) == 0 && pwrite(fd, &fresh, sizeof fresh, 0) == (ssize_t)sizeof fresh;
+    }
+    mapped = valid ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    flock(fd, LOCK_UN);
+    close(fd);  // the mapping keeps the file open
+    if (mapped == MAP_FAILED) {
+        mapped = nullptr;
+        return;
+    }
+    mapped_size = size;
+    bucket_count = wanted_buckets;
+    generation = (atomic<uint32_t> *)((char *)mapped + sizeof(Header));
+    entries = (Entry *)((char *)mapped + HEADER_SIZE);
+}
+
+PositionCache::~PositionCache() {
+    if (mapped != nullptr) munmap(mapped, mapped_size);
+}
+
+uint64_t PositionCache::pack(const CachedPosition &position, uint32_t age) {
+    return (uint64_t)(uint32_t)position.score | (uint64_t)(position.depth & 0xff) << 32 | (uint64_t)position.bound << 40 |
+           (uint64_t)(position.move_index & 0x3ff) << 42 | (uint64_t)(age & AGE_MASK) << 52;
+}
+
+CachedPosition PositionCache::unpack(uint64_t data) {
+    CachedPosition position;
+    position.score = (int32_t)(uint32_t)data;
+    position.depth = (data >> 32) & 0xff;
+    position.bound = (CachedPosition::Bound)((data >> 40) & 3);
+    position.move_index = (data >> 42) & 0x3ff;
+    return position;
+}
+
+/**
+ * an entry found by a newer search takes its age, so positions that keep coming up stay
+ * @return false if the position was never stored or has been replaced since
+ */
+bool PositionCache::probe(uint64_t key, CachedPosition &position, uint32_t age) {
+    Entry *bucket = entries + (key % bucket_count) * BUCKET_SIZE;
+    for (int i = 0; i < BUCKET_SIZE; ++i) {
+        uint64_t data = bucket[i].data.load(memory_order_relaxed);
+        if ((bucket[i].check.load(memory_order_relaxed) ^ data) != key) continue;
+        position = unpack(data);
+        if (position.bound == CachedPosition::NONE) return false;
+        if (getAge(data) != age) {
+            data = pack(position, age);
+            bucket[i].data.store(data, memory_order_relaxed);
+            bucket[i].check.store(key ^ data, memory_order_relaxed);
+        }
+        return true;
+    }
+    return false;
+}
+
+/* age comes from newSearch, a deeper result of the same position is only replaced by a newer search */
+void PositionCache::store(uint64_t key, const CachedPosition &position, uint32_t age) {
+    Entry *bucket = entries + (key % bucket_count) * BUCKET_SIZE;
+    Entry *victim = nullptr;
+    int victim_worth = 0;
+    for (int i = 0; i < BUCKET_SIZE; ++i) {
+        uint64_t data = bucket[i].data.load(memory_order_relaxed);
+        if ((bucket[i].check.load(memory_order_relaxed) ^ data) == key) {
+            CachedPosition found = unpack(data);
+            if (getAge(data) == age && found.depth > position.depth) return;
+            victim = &bucket[i];
+            break;
+        }
+        // every search since the entry was written costs it as much as a few plies of depth
+        int worth = (int)((data >> 32) & 0xff) - 4 * (int)((age - getAge(data)) & AGE_MASK);
+        if (victim == nullptr || worth < victim_worth) {
+            victim = &bucket[i];
+            victim_worth = worth;
+        }
+    }
+    uint64_t data = pack(position, age);
+    victim->data.store(data, memory_order_relaxed);
+    victim->check.store(key ^ data, memory_order_relaxed);
+}
+
+#endif /* POSITIONCACHE_HPP */
@@ -0,0 +1,220 @@
+#pragma once
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "match.hpp"
+#include "positioncache.hpp"
+
+using namespace std;
+
+struct SearchResult {
+    bool has_move = false;
+    Move best_move;
+    int score = 0;  // from the searching team's view, higher is better
+    int depth = 0;  // last fully searched depth
+};
+
+/**
+ * iterative deepening alpha-beta where the searching team maximizes and every other team minimizes
+ * stops at the deadline or once cancelled, keeping the result of the last finished depth
+ * with a cache, nodes with enough depth left reuse what earlier searches found and the root resumes past it
+ */
+class Search {
+   public:
+    static const int WIN_SCORE = 100000;
+    static const int MIN_CACHED_DEPTH = 2;  // shallower nodes cost less to search than to look up
+
+   private:
+    int team_number;
+    chrono::steady_clock::time_point deadline;
+    atomic<bool> *cancelled;
+    bool stopped = false;
+    unsigned long nodes = 0;
+    vector<vector<Move>> move_lists;  // one reused list per remaining depth
+    PositionCache *cache;
+    uint32_t cache_age = 0;
+    uint64_t lineup_key = 0;
+    uint64_t getCacheKey(Match &match) { return match.hash() ^ lineup_key; }
+    bool shouldStop();
+    int alphaBeta(Match &match, int depth, int alpha, int beta);
+
+   public:
+    Search(int team_number, chrono::steady_clock::time_point deadline, atomic<bool> *cancelled = nullptr, PositionCache *cache = nullptr)
+        : team_number(team_number), deadline(deadline), cancelled(cancelled), cache(cache != nullptr && cache->isOpen() ? cache : nullptr) {}
+    unsigned long getNodes() { return nodes; }
+    int evaluate(Match &match);
+    SearchResult run(Match &match, int max_depth = 64);
+    static uint64_t getLineupKey(Match &match, int team_number);
+};
+
+/* the same position is worth something else in another lineup or to another team */
+uint64_t Search::getLineupKey(Match &match, int team_number) {
+    uint64_t result = 0x9e3779b97f4a7c15ULL * (team_number + 1);
+    for (auto &player : match.getPlayers()) {
+        result = (result ^ (player->getType() << 8 | player->getTeamNumber())) * 0x100000001b3ULL;
+    }
+    return result;
+}
+
+bool Search::shouldStop() {
+    // clock reads are slow compared to a node, so only check every so often
+    if (!stopped && (++nodes & 1023) == 0) {
+        stopped = (cancelled != nullptr && cancelled->load()) || chrono::steady_clock::now() >= deadline;
+    }
+    return stopped;
+}
+
+/* alive extremities are worth the most, raised toes bring a foot closer to dying */
+int Search::evaluate(Match &match) {
+    Team *winning_team = match.getWinningTeam();
+    if (winning_team != nullptr) {
+        return winning_team->getTeamNumber() == team_number ? WIN_SCORE : -WIN_SCORE;
+    }
+    int score = 0;
+    for (auto &player : match.getPlayers()) {
+        if (!player->isAlive()) continue;
+        int player_score = 20;
+        for (size_t i = 0; i < player->getHandsSize(); ++i) {
+            if (player->getExtremity(Extremity::HAND, i)->isAlive()) player_score += 10;
+        }
+        for (size_t i = 0; i < player->getFeetSize(); ++i) {
+            Extremity *foot = player->getExtremity(Extremity::FOOT, i);
+            if (foot->isAlive()) player_score += 10 - foot->getCount();
+        }
+        if (player->isSkipping()) player_score -= 5;
+        score += player->getTeamNumber() == team_number ? player_score : -player_score;
+    }
+    return score;
+}
+
+int Search::alphaBeta(Match &match, int depth, int alpha, int beta) {
+    if (depth == 0 || match.getCurrentPlayer() == nullptr) return evaluate(match);
+    bool maximizing = match.getCurrentPlayer()->getTeamNumber() == team_number;
+    int best = maximizing ? -WIN_SCORE - 1 : WIN_SCORE + 1;
+    vector<Move> &moves = move_lists[depth];
+    match.getLegalMoves(moves);
+    bool cached = cache != nullptr && depth >= MIN_CACHED_DEPTH;
+    uint64_t key = 0;
+    size_t first = 0;  // searched before the others, the best move found last time
+    if (cached) {
+        key = getCacheKey(match);
+        CachedPosition found;
+        if (cache->probe(key, found, cache_age)) {
+            if (found.depth >= depth) {
+                if (found.bound == CachedPosition::EXACT) return found.score;
+                if (found.bound == CachedPosition::LOWER && found.score >= beta) return found.score;
+                if (found.bound == CachedPosition::UPPER && found.score <= alpha) return found.score;
+            }
+            if (found.move_index < (int)moves.size()) first = found.move_index;
+        }
+    }
+    int original_alpha = alpha, original_beta = beta;
+    size_t best_index = first;
+    Undo undo;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        if (shouldStop()) break;
+        size_t index = i == 0 ? first : (i <= first ? i - 1 : i);
+        match.makeMove(moves[index], undo);
+        int score = alphaBeta(match, depth - 1, alpha, beta);
+        match.unmakeMove(undo);
+        // prefer quicker wins and slower losses
+        if (score > WIN_SCORE / 2) --score;
+        if (score < -WIN_SCORE / 2) ++score;
+        if (maximizing) {
+            if (score > best) {
+                best = score;
+                best_index = index;
+            }
+            if (best > alpha) alpha = best;
+        } else {
+            if (score < best) {
+                best = score;
+                best_index = index;
+            }
+            if (best < beta) beta = best;
+        }
+        if (alpha >= beta) break;
+    }
+    if (cached && !stopped) {
+        CachedPosition position;
+        position.score = best;
+        position.depth = depth;
+        position.bound = best <= original_alpha ? CachedPosition::UPPER : (best >= original_beta ? CachedPosition::LOWER : CachedPosition::EXACT);
+        position.move_index = best_index;
+        cache->store(key, position, cache_age);
+    }
+    return best;
+}
+
+SearchResult Search::run(Match &match, int max_depth) {
+    SearchResult result;
+    vector<Move> moves = match.getLegalMoves();
+    if (moves.empty()) return result;
+    result.has_move = true;
+    result.best_move = moves[0];
+    move_lists.resize(max_depth + 1);
+    Undo undo;
+    bool maximizing = match.getCurrentPlayer()->getTeamNumber() == team_number;
+    vector<int> legal_indices;  // of moves in getLegalMoves order, as the cache stores them
+    for (size_t i = 0; i < moves.size(); ++i) {
+        legal_indices.push_back(i);
+    }
+    int first_depth = 1;
+    uint64_t key = 0;
+    if (cache != nullptr) {
+        cache_age = cache->newSearch();
+        lineup_key = getLineupKey(match, team_number);
+        key = getCacheKey(match);
+        CachedPosition found;
+        if (cache->probe(key, found, cache_age) && found.move_index < (int)moves.size()) {
+            swap(moves[0], moves[found.move_index]);
+            swap(legal_indices[0], legal_indices[found.move_index]);
+            result.best_move = moves[0];
+            // an exact result is as good as searching up to its depth again
+            if (found.bound == CachedPosition::EXACT && found.depth <= max_depth) {
+                result.score = found.score;
+                result.depth = found.depth;
+                first_depth = found.depth + 1;
+                if (found.score >= WIN_SCORE / 2 || found.score <= -WIN_SCORE / 2) return result;
+            }
+        }
+    }
+    for (int depth = first_depth; depth <= max_depth; ++depth) {
+        int alpha = -WIN_SCORE - 1, beta = WIN_SCORE + 1;
+        int best_score = maximizing ? alpha : beta;
+        size_t best_index = 0;
+        for (size_t i = 0; i < moves.size() && !shouldStop(); ++i) {
+            match.makeMove(moves[i], undo);
+            int score = alphaBeta(match, depth - 1, alpha, beta);
+            match.unmakeMove(undo);
+            if (maximizing ? score > best_score : score < best_score) {
+                best_score = score;
+                best_index = i;
+            }
+            if (maximizing && best_score > alpha) alpha = best_score;
+            if (!maximizing && best_score < beta) beta = best_score;
+        }
+        if (stopped) break;
+        result.best_move = moves[best_index];
+        result.score = best_score;
+        result.depth = depth;
+        if (cache != nullptr) {
+            CachedPosition position;
+            position.score = best_score;
+            position.depth = depth;
+            position.bound = CachedPosition::EXACT;
+            position.move_index = legal_indices[best_index];
+            cache->store(key, position, cache_age);
+        }
+        // search the best move first next time
+        swap(moves[0], moves[best_index]);
+        swap(legal_indices[0], legal_indices[best_index]);
+        if (best_score >= WIN_SCORE / 2 || best_score <= -WIN_SCORE / 2) break;
+    }
+    return result;
+}
+
+#endif /* SEARCH_HPP */
@@ -0,0 +1,182 @@
+#pragma once
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+/**
+ * hierarchical timer wheel, adding and cancelling a timer is O(1) whatever the number of timers
+ * LEVELS wheels of SLOTS slots, each level's slot spans a whole turn of the level below it
+ * timers further than the last level can reach are parked in it and placed again as it turns
+ * timers fire at most one tick late, never early
+ */
+class TimerWheel {
+   public:
+    typedef uint64_t Id;  // node index in the low half, generation in the high half
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const int LEVELS = 4;
+
+   private:
+    static const uint32_t NONE = UINT32_MAX;
+    struct Node {
+        uint64_t tick;  // tick the timer fires on
+        function<void()> callback;
+        uint32_t previous = NONE;
+        uint32_t next = NONE;
+        uint32_t slot = NONE;  // NONE while free
+        uint32_t generation = 0;
+    };
+    chrono::steady_clock::duration tick_length;
+    chrono::steady_clock::time_point start;
+    uint64_t current_tick = 0;  // next tick to run, earlier ticks have all fired
+    vector<Node> nodes;
+    uint32_t free_head = NONE;
+    vector<uint32_t> heads;  // first node of every slot, level by level
+    size_t count = 0;
+    uint64_t toTick(chrono::steady_clock::time_point time);
+    void place(uint32_t index);
+    void link(uint32_t index, uint32_t slot);
+    void unlink(uint32_t index);
+    void cascade(int level);
+
+   public:
+    TimerWheel(chrono::steady_clock::duration tick_length, chrono::steady_clock::time_point start = chrono::steady_clock::now())
+        : tick_length(tick_length), start(start), heads(LEVELS * SLOTS, uint32_t(NONE)) {}  // a copy, NONE has no definition to bind to
+    bool empty() { return count == 0; }
+    size_t size() { return count; }
+    Id add(chrono::steady_clock::time_point time, function<void()> callback);
+    bool cancel(Id id);
+    void advance(chrono::steady_clock::time_point now);
+    chrono::steady_clock::time_point getNextWakeUp();
+};
+
+/* rounds up so a timer never fires before its time */
+uint64_t TimerWheel::toTick(chrono::steady_clock::time_point time) {
+    if (time <= start) return 0;
+    return (time - start + tick_length - chrono::steady_clock::duration(1)) / tick_length;
+}
+
+void TimerWheel::link(uint32_t index, uint32_t slot) {
+    Node &node = nodes[index];
+    node.slot = slot;
+    node.previous = NONE;
+    node.next = heads[slot];
+    if (node.next != NONE) nodes[node.next].previous = index;
+    heads[slot] = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node &node = nodes[index];
+    if (node.previous != NONE) {
+        nodes[node.previous].next = node.next;
+    } else {
+        heads[node.slot] = node.next;
+    }
+    if (node.next != NONE) nodes[node.next].previous = node.previous;
+    node.previous = node.next = NONE;
+}
+
+/* puts the node in the lowest level whose span reaches its tick */
+void TimerWheel::place(uint32_t index) {
+    uint64_t tick = nodes[index].tick;
+    if (tick < current_tick) tick = current_tick;
+    uint64_t delta = tick - current_tick;
+    for (int level = 0; level < LEVELS; ++level) {
+        if (delta < ((uint64_t)1 << (SLOT_BITS * (level + 1)))) {
+            link(index, level * SLOTS + ((tick >> (SLOT_BITS * level)) & (SLOTS - 1)));
+            return;
+        }
+    }
+    // out of reach, park it in the farthest slot of the last level
+    uint64_t farthest = current_tick + ((uint64_t)1 << (SLOT_BITS * LEVELS)) - 1;
+    link(index, (LEVELS - 1) * SLOTS + ((farthest >> (SLOT_BITS * (LEVELS - 1))) & (SLOTS - 1)));
+}
+
+/* @return an id for cancel, callback runs from advance */
+TimerWheel::Id TimerWheel::add(chrono::steady_clock::time_point time, function<void()> callback) {
+    uint32_t index;
+    if (free_head != NONE) {
+        index = free_head;
+        free_head = nodes[index].next;
+    } else {
+        index = nodes.size();
+        nodes.push_back(Node());
+    }
+    Node &node = nodes[index];
+    node.tick = toTick(time);
+    node.callback = callback;
+    place(index);
+    ++count;
+    return ((Id)node.generation << 32) | index;
+}
+
+/* @return false if the timer already fired or was cancelled */
+bool TimerWheel::cancel(Id id) {
+    uint32_t index = (uint32_t)id;
+    if (index >= nodes.size()) return false;
+    Node &node = nodes[index];
+    if (node.slot == NONE || node.generation != (uint32_t)(id >> 32)) return false;
+    unlink(index);
+    node.callback = nullptr;
+    node.slot = NONE;
+    ++node.generation;  // stale ids of this node no longer match
+    node.next = free_head;
+    free_head = index;
+    --count;
+    return true;
+}
+
+/* moves the slot level is now entering down to the levels below */
+void TimerWheel::cascade(int level) {
+    uint32_t slot = level * SLOTS + ((current_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    uint32_t index = heads[slot];
+    heads[slot] = NONE;
+    while (index != NONE) {
+        uint32_t next = nodes[index].next;
+        place(index);
+        index = next;
+    }
+}
+
+/* runs every timer due by now, callbacks may add and cancel timers */
+void TimerWheel::advance(chrono::steady_clock::time_point now) {
+    uint64_t target = toTick(now);
+    // a timer at exactly now rounds to this tick, so it is due as well
+    if (start + tick_length * target == now) ++target;
+    while (current_tick < target) {
+        for (int level = 1; level < LEVELS; ++level) {
+            if ((current_tick & (((uint64_t)1 << (SLOT_BITS * level)) - 1)) != 0) break;
+            cascade(level);
+        }
+        uint32_t slot = current_tick & (SLOTS - 1);
+        while (heads[slot] != NONE) {
+            uint32_t index = heads[slot];
+            function<void()> callback = nodes[index].callback;
+            cancel(((Id)nodes[index].generation << 32) | index);
+            callback();
+        }
+        ++current_tick;
+    }
+}
+
+/**
+ * @return the time advance next has work to do, either a due timer or a cascade
+ * the latest time possible if there are no timers
+ */
+chrono::steady_clock::time_point TimerWheel::getNextWakeUp() {
+    if (count == 0) return chrono::steady_clock::time_point::max();
+    uint64_t tick = current_tick;
+    for (int i = 0; i < SLOTS; ++i, ++tick) {
+        if ((tick & (SLOTS - 1)) == 0) break;  // a higher level cascades here
+        if (heads[tick & (SLOTS - 1)] != NONE) break;
+    }
+    return start + tick_length * tick;
+}
+
+#endif /* TIMERWHEEL_HPP */
@@ -0,0 +1,521 @@
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "match.hpp"
+#include "search.hpp"
+
+using namespace std;
+
+/**
+ * plays bots against each other over every class and team setup of two groups and rates them with Elo
+ * usage: tournament <bot> <bot> ... [-n max players] [-g max games per pairing] [-r swiss rounds] [-s seed] [-j threads]
+ * bots: random, greedy, ab:<depth> for alpha-beta to a fixed depth, mcts:<playouts> for Monte Carlo tree search
+ * example: tournament random greedy ab:2 ab:4 mcts:200 mcts:1000 -n 3 -j 8
+ * without -r every pair of bots plays (round robin), with it bots of close ratings are paired for that many rounds (Swiss)
+ * games are played a chunk at a time and a pairing stops once its score is significant, or after max games
+ * every game is seeded from the seed, the pairing and the game number, so results don't depend on threads
+ * build: g++ -std=c++11 -O2 -pthread tournament.cpp -o tournament
+ */
+
+const char *CLASS_NAMES[] = {"human", "alien", "zombie", "doggo"};
+const int CLASS_COUNT = 4;
+const int MAX_ACTIONS = 1000;      // games this long are counted as draws
+const int PLAYOUT_ACTIONS = 200;   // random playouts this long are counted as draws
+const int CHUNK_GAMES = 32;        // games of a pairing between two looks at its score
+const double SIGNIFICANT_Z = 3.0;  // rather than 1.96, since the score is looked at after every chunk
+const double ELO_PER_NEPER = 400 / log(10.0);
+
+struct Strategy {
+    enum Kind { RANDOM,
+                GREEDY,
+                ALPHA_BETA,
+                MCTS };
+    Kind kind;
+    int budget = 0;  // depth for ALPHA_BETA, playouts for MCTS
+    string name;
+};
+
+/* @return false if name is not a bot */
+bool parseStrategy(string name, Strategy &strategy) {
+    strategy.name = name;
+    size_t colon = name.find(':');
+    string kind = name.substr(0, colon);
+    if (colon == string::npos) {
+        strategy.kind = kind == "random" ? Strategy::RANDOM : Strategy::GREEDY;
+        return kind == "random" || kind == "greedy";
+    }
+    if (!isValidInt(name.substr(colon + 1))) return false;
+    strategy.budget = stoi(name.substr(colon + 1));
+    strategy.kind = kind == "ab" ? Strategy::ALPHA_BETA : Strategy::MCTS;
+    return (kind == "ab" && 1 <= strategy.budget && strategy.budget <= 64) || (kind == "mcts" && strategy.budget >= 1);
+}
+
+/* the best move by Search::evaluate one action ahead, ties broken at random */
+Move chooseGreedy(Match &match, vector<Move> &moves, mt19937_64 &random) {
+    Search search(match.getCurrentPlayer()->getTeamNumber(), chrono::steady_clock::time_point::max());
+    vector<size_t> best;
+    int best_score = 0;
+    Undo undo;
+    for (size_t i = 0; i < moves.size(); ++i) {
+        match.makeMove(moves[i], undo);
+        int score = search.evaluate(match);
+        match.unmakeMove(undo);
+        if (best.empty() || score > best_score) {
+            best.clear();
+            best_score = score;
+        }
+        if (score == best_score) best.push_back(i);
+    }
+    return moves[best[random() % best.size()]];
+}
+
+struct MctsNode {
+    int parent;
+    Move move;
+    int team_number;  // of the player who made move, wins are counted for this team
+    vector<Move> untried;
+    vector<int> children;
+    uint32_t visits = 0;
+    double wins = 0;
+};
+
+/**
+ * UCT with random playouts, the tree lives for one move and every playout is undone back to the root
+ * @return the most visited move
+ */
+Move chooseMcts(Match &match, vector<Move> &moves, int playouts, mt19937_64 &random) {
+    vector<MctsNode> nodes(1);
+    nodes[0].parent = -1;
+    nodes[0].untried = moves;
+    vector<Undo> undos(64 + PLAYOUT_ACTIONS);
+    vector<Move> playout_moves;
+    for (int playout = 0; playout < playouts; ++playout) {
+        int node = 0;
+        size_t depth = 0;
+        auto makeMove = [&](Move &move) {
+            if (depth == undos.size()) undos.resize(2 * undos.size());
+            match.makeMove(move, undos[depth++]);
+        };
+        while (nodes[node].untried.empty() && !nodes[node].children.empty()) {
+            int best = -1;
+            double best_value = 0;
+            for (auto &child : nodes[node].children) {
+                double value = nodes[child].wins / nodes[child].visits + 1.4 * sqrt(log((double)nodes[node].visits) / nodes[child].visits);
+                if (best == -1 || value > best_value) {
+                    best = child;
+                    best_value = value;
+                }
+            }
+            makeMove(nodes[best].move);
+            node = best;
+        }
+        if (!nodes[node].untried.empty()) {
+            vector<Move> &untried = nodes[node].untried;
+            swap(untried[random() % untried.size()], untried.back());
+            MctsNode child;
+            child.parent = node;
+            child.move = untried.back();
+            child.team_number = match.getCurrentPlayer()->getTeamNumber();
+            untried.pop_back();
+            makeMove(child.move);
+            match.getLegalMoves(child.untried);
+            nodes.push_back(child);
+            nodes[node].children.push_back(nodes.size() - 1);
+            node = nodes.size() - 1;
+        }
+        for (int actions = 0; actions < PLAYOUT_ACTIONS; ++actions) {
+            match.getLegalMoves(playout_moves);
+            if (playout_moves.empty()) break;
+            makeMove(playout_moves[random() % playout_moves.size()]);
+        }
+        Team *winning_team = match.getWinningTeam();
+        for (; node != -1; node = nodes[node].parent) {
+            ++nodes[node].visits;
+            if (node == 0) break;
+            nodes[node].wins += winning_team == nullptr ? 0.5 : winning_team->getTeamNumber() == nodes[node].team_number;
+        }
+        while (depth > 0) {
+            match.unmakeMove(undos[--depth]);
+        }
+    }
+    int best = nodes[0].children[0];
+    for (auto &child : nodes[0].children) {
+        if (nodes[child].visits > nodes[best].visits) best = child;
+    }
+    return nodes[best].move;
+}
+
+Move chooseMove(Strategy &strategy, Match &match, vector<Move> &moves, mt19937_64 &random) {
+    if (moves.size() == 1) return moves[0];
+    switch (strategy.kind) {
+        case Strategy::RANDOM:
+            return moves[random() % moves.size()];
+        case Strategy::GREEDY:
+            return chooseGreedy(match, moves, random);
+        case Strategy::ALPHA_BETA:
+            // no deadline, so the same position always gets the same move
+            return Search(match.getCurrentPlayer()->getTeamNumber(), chrono::steady_clock::time_point::max()).run(match, strategy.budget).best_move;
+        default:
+            return chooseMcts(match, moves, strategy.budget, random);
+    }
+}
+
+/* CPU time of the calling thread, so games on other cores don't count */
+uint64_t getThreadNanoseconds() {
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* every lineup of player_count players split into groups 1 and 2 */
+void addLineups(int player_count, vector<vector<string>> &lineups) {
+    for (int groups = 1; groups < (1 << player_count) - 1; ++groups) {
+        vector<int> classes(player_count, 0);
+        for (;;) {
+            vector<string> lineup;
+            for (int i = 0; i < player_count; ++i) {
+                lineup.push_back(string(CLASS_NAMES[classes[i]]) + ":" + to_string(1 + ((groups >> i) & 1)));
+            }
+            lineups.push_back(lineup);
+            int i = 0;
+            while (i < player_count && ++classes[i] == CLASS_COUNT) classes[i++] = 0;
+            if (i == player_count) break;
+        }
+    }
+}
+
+struct GameResult {
+    double score = 0.5;  // for the first bot of the pairing
+    uint64_t nanoseconds[2] = {};
+    uint64_t moves[2] = {};
+};
+
+/**
+ * the first bot plays group 1 unless swapped, a game that stalls or runs past MAX_ACTIONS is a draw
+ * @return false if lineup is not a valid lineup, and nothing is played
+ */
+bool playGame(Strategy *bots[2], vector<string> &lineup, bool swapped, uint64_t seed, GameResult &result) {
+    vector<Player *> players;
+    if (!createLineup(lineup, players)) return false;
+    Match match(players);
+    mt19937_64 random(seed);
+    vector<Move> moves;
+    Undo undo;
+    for (int actions = 0; actions < MAX_ACTIONS && match.getCurrentPlayer() != nullptr; ++actions) {
+        int side = (match.getCurrentPlayer()->getTeamNumber() == 1) == swapped;
+        match.getLegalMoves(moves);
+        if (moves.empty()) {
+            match.skipTurn();
+            continue;
+        }
+        uint64_t start = getThreadNanoseconds();
+        Move move = chooseMove(*bots[side], match, moves, random);
+        result.nanoseconds[side] += getThreadNanoseconds() - start;
+        ++result.moves[side];
+        match.makeMove(move, undo);
+    }
+    Team *winning_team = match.getWinningTeam();
+    if (winning_team != nullptr) result.score = (winning_team->getTeamNumber() == 1) != swapped;
+    return true;
+}
+
+/* games between two bots, every score from the view of first */
+struct Pairing {
+    int first, second;
+    uint64_t games = 0;
+    uint64_t wins = 0, draws = 0, losses = 0;
+    bool done = false;
+    string reason;
+    double getScore() { return games == 0 ? 0.5 : (wins + 0.5 * draws) / games; }
+    double getStandardError();
+    void add(GameResult &result);
+};
+
+/* of the mean score, from the spread of the results themselves */
+double Pairing::getStandardError() {
+    if (games < 2) return 1;
+    double score = getScore();
+    double variance = (wins + 0.25 * draws) / games - score * score;
+    return sqrt(max(variance, 0.0) / games);
+}
+
+void Pairing::add(GameResult &result) {
+    ++games;
+    if (result.score == 1) {
+        ++wins;
+    } else if (result.score == 0) {
+        ++losses;
+    } else {
+        ++draws;
+    }
+}
+
+/* Elo difference that predicts score, kept finite for a clean sweep of games */
+double getElo(double score, uint64_t games) {
+    double limit = 0.5 / max<uint64_t>(games, 1);
+    score = min(max(score, limit), 1 - limit);
+    return ELO_PER_NEPER * log(score / (1 - score));
+}
+
+string formatElo(double elo) {
+    ostringstream result;
+    result << showpos << fixed << setprecision(0) << elo;
+    return result.str();
+}
+
+struct Rating {
+    double elo = 0;
+    double error = 0;  // standard error in Elo
+    uint64_t games = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t moves = 0;
+};
+
+/**
+ * Bradley-Terry fit of every result so far by minorization-maximization, with one virtual draw per pairing
+ * so a bot that won or lost everything still gets a finite rating, ratings average to 0
+ * the errors come from the curvature of the likelihood at the fit
+ */
+void fitRatings(vector<Pairing> &pairings, vector<Rating> &ratings) {
+    size_t count = ratings.size();
+    vector<vector<double>> points(count, vector<double>(count, 0)), games(count, vector<double>(count, 0));
+    for (auto &pairing : pairings) {
+        if (pairing.games == 0) continue;
+        double score = pairing.wins + 0.5 * pairing.draws;
+        points[pairing.first][pairing.second] += score + 0.5;
+        points[pairing.second][pairing.first] += pairing.games - score + 0.5;
+        games[pairing.first][pairing.second] += pairing.games + 1;
+        games[pairing.second][pairing.first] += pairing.games + 1;
+    }
+    vector<double> strengths(count, 1);
+    for (int iteration = 0; iteration < 1000; ++iteration) {
+        double log_sum = 0;
+        for (size_t i = 0; i < count; ++i) {
+            double won = 0, expected = 0;
+            for (size_t j = 0; j < count; ++j) {
+                won += points[i][j];
+                expected += games[i][j] / (strengths[i] + strengths[j]);
+            }
+            if (expected > 0) strengths[i] = won / expected;
+            log_sum += log(strengths[i]);
+        }
+        double scale = exp(log_sum / count);
+        for (auto &strength : strengths) {
+            strength /= scale;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        double information = 0;
+        for (size_t j = 0; j < count; ++j) {
+            double p = strengths[i] / (strengths[i] + strengths[j]);
+            information += games[i][j] * p * (1 - p);
+        }
+        ratings[i].elo = ELO_PER_NEPER * log(strengths[i]);
+        ratings[i].error = information > 0 ? ELO_PER_NEPER / sqrt(information) : 0;
+    }
+}
+
+/* @return whether every bot's rating is significantly apart from the next one's */
+bool isRankingSignificant(vector<Rating> &ratings) {
+    vector<Rating> sorted = ratings;
+    sort(sorted.begin(), sorted.end(), [](const Rating &a, const Rating &b) { return a.elo > b.elo; });
+    for (size_t i = 0; i + 1 < sorted.size(); ++i) {
+        double error = sqrt(sorted[i].error * sorted[i].error + sorted[i + 1].error * sorted[i + 1].error);
+        if (sorted[i].games == 0 || sorted[i].elo - sorted[i + 1].elo < SIGNIFICANT_Z * error) return false;
+    }
+    return true;
+}
+
+/* bots next to each other in rating play, preferring opponents they have met least, an odd bot out sits the round */
+vector<size_t> pairSwissRound(vector<Pairing> &pairings, vector<Rating> &ratings, vector<vector<size_t>> &pairing_index) {
+    vector<size_t> order(ratings.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ratings[a].elo > ratings[b].elo; });
+    vector<bool> paired(order.size(), false);
+    vector<size_t> round;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (paired[i]) continue;
+        size_t best = order.size();
+        for (size_t j = i + 1; j < order.size(); ++j) {
+            if (paired[j]) continue;
+            Pairing &pairing = pairings[pairing_index[order[i]][order[j]]];
+            if (pairing.done) continue;
+            if (best == order.size() || pairing.games < pairings[pairing_index[order[i]][order[best]]].games) best = j;
+        }
+        if (best == order.size()) continue;
+        paired[i] = paired[best] = true;
+        round.push_back(pairing_index[order[i]][order[best]]);
+    }
+    return round;
+}
+
+uint64_t mixSeed(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: tournament <bot> <bot> ... [-n max players] [-g max games per pairing] [-r swiss rounds] [-s seed] [-j threads]" << endl;
+        return 1;
+    }
+    int max_players = 2;
+    int max_games = 0;
+    int swiss_rounds = 0;
+    int seed = 1;
+    int threads = thread::hardware_concurrency();
+    vector<Strategy> bots;
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        Strategy bot;
+        if ((argument == "-n" || argument == "-g" || argument == "-r" || argument == "-s" || argument == "-j") && i + 1 < argc && isValidInt(argv[i + 1])) {
+            int value = stoi(argv[++i]);
+            (argument == "-n" ? max_players : argument == "-g" ? max_games : argument == "-r" ? swiss_rounds : argument == "-s" ? seed : threads) = value;
+        } else if (parseStrategy(argument, bot)) {
+            bots.push_back(bot);
+        } else {
+            cerr << "Unknown bot " << argument << ". Bots are random, greedy, ab:<depth> and mcts:<playouts>." << endl;
+            return 1;
+        }
+    }
+    if (bots.size() < 2 || max_players < 2 || max_players > MAX_PLAYERS || max_games < 0 || swiss_rounds < 0) {
+        cerr << "There must be at least 2 bots and 2 to 6 players, and games and rounds can't be negative." << endl;
+        return 1;
+    }
+    if (threads < 1) threads = 1;
+    vector<vector<string>> lineups;
+    for (int player_count = 2; player_count <= max_players; ++player_count) {
+        addLineups(player_count, lineups);
+    }
+    // a pairing meets the lineups in this order, so a pairing stopped early has still seen a fair sample
+    shuffle(lineups.begin(), lineups.end(), mt19937_64(mixSeed(seed)));
+    // by default every lineup is played once from each side
+    if (max_games == 0) max_games = 2 * lineups.size();
+    int chunk_games = min(CHUNK_GAMES, max_games);
+
+    vector<Pairing> pairings;
+    vector<vector<size_t>> pairing_index(bots.size(), vector<size_t>(bots.size()));
+    for (size_t i = 0; i < bots.size(); ++i) {
+        for (size_t j = i + 1; j < bots.size(); ++j) {
+            pairing_index[i][j] = pairing_index[j][i] = pairings.size();
+            Pairing pairing;
+            pairing.first = i;
+            pairing.second = j;
+            pairings.push_back(pairing);
+        }
+    }
+    vector<Rating> ratings(bots.size());
+    cout << "Bots: " << bots.size() << ", lineups: " << lineups.size() << ", threads: " << threads << ", " << (swiss_rounds == 0 ? "round robin" : "swiss") << endl;
+    auto start = chrono::steady_clock::now();
+
+    bool ranking_significant = false;
+    for (int round_number = 1; swiss_rounds == 0 || round_number <= swiss_rounds; ++round_number) {
+        vector<size_t> round;
+        if (swiss_rounds == 0) {
+            for (size_t i = 0; i < pairings.size(); ++i) {
+                if (!pairings[i].done) round.push_back(i);
+            }
+        } else {
+            round = pairSwissRound(pairings, ratings, pairing_index);
+        }
+        if (round.empty()) break;
+
+        // a chunk of every pairing in the round, results kept in job order so the threads don't change them
+        vector<pair<size_t, uint64_t>> jobs;
+        for (auto &index : round) {
+            for (int i = 0; i < chunk_games && pairings[index].games + i < (uint64_t)max_games; ++i) {
+                jobs.push_back(make_pair(index, pairings[index].games + i));
+            }
+        }
+        vector<GameResult> results(jobs.size());
+        atomic<size_t> next_job(0);
+        atomic<bool> invalid(false);
+        vector<thread> workers;
+        for (int i = 0; i < threads; ++i) {
+            workers.push_back(thread([&]() {
+                for (size_t job = next_job++; job < jobs.size(); job = next_job++) {
+                    Pairing &pairing = pairings[jobs[job].first];
+                    uint64_t game = jobs[job].second;
+                    Strategy *players[2] = {&bots[pairing.first], &bots[pairing.second]};
+                    uint64_t game_seed = mixSeed(mixSeed(mixSeed(seed) ^ jobs[job].first) ^ game);
+                    if (!playGame(players, lineups[(game / 2) % lineups.size()], game % 2 == 1, game_seed, results[job])) {
+                        invalid = true;
+                        return;
+                    }
+                }
+            }));
+        }
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        if (invalid) {
+            cerr << "Invalid players or groups. There must be 2 to 6 players in groups 1 to n." << endl;
+            return 1;
+        }
+        for (size_t job = 0; job < jobs.size(); ++job) {
+            Pairing &pairing = pairings[jobs[job].first];
+            pairing.add(results[job]);
+            int sides[2] = {pairing.first, pairing.second};
+            for (int side = 0; side < 2; ++side) {
+                ratings[sides[side]].nanoseconds += results[job].nanoseconds[side];
+                ratings[sides[side]].moves += results[job].moves[side];
+                ++ratings[sides[side]].games;
+            }
+        }
+        for (auto &index : round) {
+            Pairing &pairing = pairings[index];
+            if (fabs(pairing.getScore() - 0.5) > SIGNIFICANT_Z * pairing.getStandardError()) {
+                pairing.done = true;
+                pairing.reason = "significant";
+            } else if (pairing.games >= (uint64_t)max_games) {
+                pairing.done = true;
+                pairing.reason = "max games";
+            }
+        }
+        fitRatings(pairings, ratings);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Round " << round_number << ": " << jobs.size() << " games, " << fixed << setprecision(1) << seconds << "s" << endl;
+        if (swiss_rounds != 0 && isRankingSignificant(ratings)) {
+            ranking_significant = true;
+            break;
+        }
+    }
+
+    vector<size_t> order(bots.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ratings[a].elo > ratings[b].elo; });
+    cout << "Ratings, Elo with a 95% interval and CPU time per move:" << endl;
+    for (size_t rank = 0; rank < order.size(); ++rank) {
+        Rating &rating = ratings[order[rank]];
+        cout << "  " << (rank + 1) << ". " << left << setw(12) << bots[order[rank]].name << right << setw(6) << formatElo(rating.elo)
+             << " +/- " << setw(4) << fixed << setprecision(0) << 1.96 * rating.error << "  " << setw(10) << setprecision(3)
+             << (rating.moves == 0 ? 0.0 : rating.nanoseconds / 1e6 / rating.moves) << " ms  " << rating.games << " games" << endl;
+    }
+    cout << "Pairings:" << endl;
+    for (auto &pairing : pairings) {
+        if (pairing.games == 0) continue;
+        double score = pairing.getScore(), error = 1.96 * pairing.getStandardError();
+        cout << "  " << bots[pairing.first].name << " vs " << bots[pairing.second].name << ": +" << pairing.wins << " =" << pairing.draws << " -" << pairing.losses
+             << ", " << fixed << setprecision(1) << 100 * score << "%, Elo " << formatElo(getElo(score, pairing.games)) << " ["
+             << formatElo(getElo(score - error, pairing.games)) << ", " << formatElo(getElo(score + error, pairing.games)) << "]"
+             << (pairing.reason.empty() ? "" : ", " + pairing.reason) << endl;
+    }
+    if (ranking_significant) cout << "Stopped early, every rating is significantly apart from the next." << endl;
+    return 0;
+}
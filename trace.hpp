@@ -0,0 +1,188 @@
+#pragma once
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+/**
+ * optional Chrome trace-event spans, compiled in with -DCHOPSTICKS_TRACE and expanding to nothing otherwise
+ * the trace goes to $CHOPSTICKS_TRACE_FILE, or chopsticks-trace-<pid>.json, for chrome://tracing or Perfetto
+ * TRACE_SPAN(name) times the rest of the enclosing scope on the calling thread's track, name must be a literal
+ * TRACE_SPAN_ON(track, name) uses a track of its own instead, any pointer identifies one, so coroutines
+ * interleaving on one thread each get a clean timeline
+ */
+#ifdef CHOPSTICKS_TRACE
+
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mpscqueue.hpp"
+
+using namespace std;
+
+struct TraceEvent {
+    const char *name;
+    uint64_t track;
+    int64_t start;     // nanoseconds since the trace started
+    int64_t duration;  // -1 for a track name, which is in label
+    const char *arg_name;
+    int64_t arg_value;
+    string label;
+};
+
+/* owns the output file and the thread writing it, threads hand it whole buffers of events */
+class Tracer {
+   private:
+    MpscQueue<vector<TraceEvent> *> queue;
+    chrono::steady_clock::time_point start;
+    FILE *file = nullptr;
+    atomic<bool> stopping;
+    atomic<uint64_t> next_thread_track;
+    thread writer;
+    void write();
+    void writeEvent(TraceEvent &event);
+
+   public:
+    Tracer();
+    ~Tracer();
+    static Tracer &instance() {
+        static Tracer tracer;
+        return tracer;
+    }
+    int64_t now() { return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(); }
+    uint64_t newThreadTrack() { return next_thread_track++; }
+    void submit(vector<TraceEvent> *events);
+};
+
+Tracer::Tracer() : queue(256), start(chrono::steady_clock::now()), stopping(false), next_thread_track(1) {
+    const char *path = getenv("CHOPSTICKS_TRACE_FILE");
+    string default_path = "chopsticks-trace-" + to_string(getpid()) + ".json";
+    file = fopen(path != nullptr ? path : default_path.c_str(), "w");
+    // the array is never closed, trace viewers accept that and a crash can't leave the file invalid
+    if (file != nullptr) fputs("[\n", file);
+    writer = thread(&Tracer::write, this);
+}
+
+Tracer::~Tracer() {
+    stopping = true;
+    writer.join();
+    if (file != nullptr) fclose(file);
+}
+
+/* takes ownership of events, waits for room like Scheduler::post */
+void Tracer::submit(vector<TraceEvent> *events) {
+    while (!queue.tryPush(events)) {
+        this_thread::yield();
+    }
+}
+
+void Tracer::writeEvent(TraceEvent &event) {
+    if (file == nullptr) return;
+    if (event.duration < 0) {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%llu,\"args\":{\"name\":\"%s\"}},\n", (int)getpid(), (unsigned long long)event.track, event.label.c_str());
+        return;
+    }
+    fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f", event.name, (int)getpid(), (unsigned long long)event.track, event.start / 1000.0, event.duration / 1000.0);
+    if (event.arg_name != nullptr) fprintf(file, ",\"args\":{\"%s\":%lld}", event.arg_name, (long long)event.arg_value);
+    fputs("},\n", file);
+}
+
+/* formatting and writing happen here so traced threads only append to memory */
+void Tracer::write() {
+    vector<vector<TraceEvent> *> batch;
+    for (;;) {
+        bool stopped = stopping;
+        if (queue.prepareSleep()) {
+            pollfd wake = {queue.getWakeFd(), POLLIN, 0};
+            poll(&wake, 1, stopped ? 0 : 100);
+            queue.finishSleep();
+        }
+        batch.clear();
+        queue.popBatch(batch, 64);
+        for (auto &events : batch) {
+            for (auto &event : *events) {
+                writeEvent(event);
+            }
+            delete events;
+        }
+        if (file != nullptr) fflush(file);
+        if (stopped && batch.empty()) return;
+    }
+}
+
+/* events of one thread, handed to the tracer when full, when they get old, and when the thread exits */
+struct TraceBuffer {
+    static const size_t CAPACITY = 1024;
+    uint64_t track;
+    vector<TraceEvent> *events;
+    TraceBuffer() : track(Tracer::instance().newThreadTrack()), events(new vector<TraceEvent>()) { events->reserve(CAPACITY); }
+    ~TraceBuffer() { flush(); }
+    void add(TraceEvent event);
+    void flush();
+    static TraceBuffer &local() {
+        static thread_local TraceBuffer buffer;
+        return buffer;
+    }
+};
+
+void TraceBuffer::add(TraceEvent event) {
+    events->push_back(event);
+    // a quiet thread still shows up within about a second
+    if (events->size() >= CAPACITY || event.start + event.duration - events->front().start > 1000000000) flush();
+}
+
+void TraceBuffer::flush() {
+    if (events->empty()) return;
+    Tracer::instance().submit(events);
+    events = new vector<TraceEvent>();
+    events->reserve(CAPACITY);
+}
+
+/* records from construction to destruction, which may be on another thread for a coroutine frame */
+class TraceSpan {
+   private:
+    const char *name;
+    uint64_t track;
+    const char *arg_name;
+    int64_t arg_value;
+    int64_t start;
+
+   public:
+    TraceSpan(const char *name, const void *track = nullptr, const char *arg_name = nullptr, int64_t arg_value = 0)
+        : name(name), track((uint64_t)(uintptr_t)track), arg_name(arg_name), arg_value(arg_value), start(Tracer::instance().now()) {}
+    TraceSpan(const TraceSpan &other) = delete;
+    ~TraceSpan() {
+        TraceBuffer &buffer = TraceBuffer::local();
+        buffer.add(TraceEvent{name, track != 0 ? track : buffer.track, start, Tracer::instance().now() - start, arg_name, arg_value, string()});
+    }
+};
+
+/* names the track in the viewer, a null track is the calling thread's */
+void nameTraceTrack(const void *track, string label) {
+    TraceBuffer &buffer = TraceBuffer::local();
+    uint64_t id = track != nullptr ? (uint64_t)(uintptr_t)track : buffer.track;
+    buffer.add(TraceEvent{"", id, Tracer::instance().now(), -1, nullptr, 0, label});
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+#define TRACE_SPAN_ON(track, name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, track)
+#define TRACE_SPAN_ON_ARG(track, name, arg_name, arg_value) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name, track, arg_name, arg_value)
+#define TRACE_NAME_TRACK(track, label) nameTraceTrack(track, label)
+
+#else
+
+#define TRACE_SPAN(name)
+#define TRACE_SPAN_ON(track, name)
+#define TRACE_SPAN_ON_ARG(track, name, arg_name, arg_value)
+#define TRACE_NAME_TRACK(track, label)
+
+#endif /* CHOPSTICKS_TRACE */
+
+#endif /* TRACE_HPP */